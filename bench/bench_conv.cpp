@@ -0,0 +1,144 @@
+// Convolution engine benchmark for larger inputs.
+//
+// Runs the first layer's 5x5 convolution (6 maps by default) on square
+// inputs of each size with every engine in conv_engine.h and reports
+// us/image, GFLOP/s counted as the direct algorithm's 2 * 25 flops per
+// output, and the largest difference from the direct output. The last line
+// per size is the engine conv_autotune picks. Exits non-zero when an engine
+// differs from the direct output by more than --tolerance, so the numeric
+// check can run unattended (ctest runs it on small sizes).
+
+#include "conv_engine.h"
+#include "cnn_helper.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static void fill(float *p, size_t n, unsigned int seed) {
+    for (size_t i = 0; i < n; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        p[i] = (float)(seed >> 8) / (float)(1u << 24) - 0.5f;
+    }
+}
+
+// Best of `repeats` batches of at least min_seconds
+static double time_engine(ConvEngine engine, const std::vector<float> &input, int size, std::vector<float> &output,
+                          const std::vector<float> &weight, const std::vector<float> &bias, int maps,
+                          double min_seconds, int repeats) {
+    conv5x5(engine, &input[0], size, size, &output[0], &weight[0], &bias[0], maps);
+    double best = 0;
+    for (int r = 0; r < repeats; ++r) {
+        long calls = 0;
+        double start = wall_seconds(), elapsed;
+        do {
+            conv5x5(engine, &input[0], size, size, &output[0], &weight[0], &bias[0], maps);
+            calls++;
+            elapsed = wall_seconds() - start;
+        } while (elapsed < min_seconds);
+        if (r == 0 || elapsed / calls < best) {
+            best = elapsed / calls;
+        }
+    }
+    return best;
+}
+
+int main(int argc, const char **argv) {
+    std::vector<int> sizes;
+    int maps = 6;
+    int num_threads = 0;
+    double min_seconds = 0.05;
+    int repeats = 5;
+    double tolerance = 1e-4;
+
+    for (int i = 1; i < argc; ++i) {
+        if ((strcmp(argv[i], "--sizes") == 0 || strcmp(argv[i], "-s") == 0) && i + 1 < argc) {
+            const char *p = argv[++i];
+            while (*p) {
+                int v = atoi(p);
+                if (v >= 5) sizes.push_back(v);
+                const char *comma = strchr(p, ',');
+                if (!comma) break;
+                p = comma + 1;
+            }
+        } else if (strcmp(argv[i], "--maps") == 0 && i + 1 < argc) {
+            maps = atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) {
+            repeats = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [OPTIONS]\n", argv[0]);
+            printf("Options:\n");
+            printf("  -s, --sizes <list>      Comma separated input sizes in pixels (default: 28,64,128)\n");
+            printf("  --maps <N>              Output maps (default: 6)\n");
+            printf("  -t, --threads <N>       Set number of OpenMP threads (openmp backend)\n");
+            printf("  --min-time <seconds>    Minimum time per measured batch (default: 0.05)\n");
+            printf("  --repeats <N>           Measured batches per engine, best is reported (default: 5)\n");
+            printf("  --tolerance <F>         Largest difference from direct accepted (default: 1e-4)\n");
+            printf("  --help, -h              Show this help message\n");
+            return 0;
+        }
+    }
+    if (sizes.empty()) {
+        sizes.push_back(28);
+        sizes.push_back(64);
+        sizes.push_back(128);
+    }
+    if (maps < 1) {
+        maps = 1;
+    }
+    if (repeats < 1) {
+        repeats = 1;
+    }
+#ifdef _OPENMP
+    if (num_threads > 0) {
+        omp_set_num_threads(num_threads);
+    }
+#endif
+
+    int failures = 0;
+    printf("backend,size,engine,us_per_image,gflops,max_abs_diff\n");
+    for (size_t s = 0; s < sizes.size(); ++s) {
+        int size = sizes[s];
+        size_t outputs = (size_t)maps * (size - 4) * (size - 4);
+        std::vector<float> input((size_t)size * size), weight(maps * 25), bias(maps);
+        std::vector<float> reference(outputs), output(outputs);
+        fill(&input[0], input.size(), 1);
+        fill(&weight[0], weight.size(), 2);
+        fill(&bias[0], bias.size(), 3);
+        conv5x5(CONV_DIRECT, &input[0], size, size, &reference[0], &weight[0], &bias[0], maps);
+
+        for (int e = 0; e < num_conv_engines; ++e) {
+            double sec = time_engine((ConvEngine)e, input, size, output, weight, bias, maps, min_seconds, repeats);
+            double diff = 0;
+            for (size_t i = 0; i < outputs; ++i) {
+                double d = fabs(output[i] - reference[i]);
+                if (std::isnan(d)) {
+                    diff = d;  // fmax would skip it
+                    break;
+                }
+                diff = fmax(diff, d);
+            }
+            printf("%s,%d,%s,%.2f,%.3f,%.2e\n", CNN_BACKEND_NAME, size, conv_engine_name((ConvEngine)e),
+                   sec * 1e6, 2.0 * 25 * outputs / sec * 1e-9, diff);
+            fflush(stdout);
+            if (!(diff <= tolerance)) {
+                fprintf(stderr, "%s differs from direct by %.2e at size %d (tolerance %.2e)\n",
+                        conv_engine_name((ConvEngine)e), diff, size, tolerance);
+                failures++;
+            }
+        }
+        printf("%s,%d,autotune -> %s,,,\n", CNN_BACKEND_NAME, size,
+               conv_engine_name(conv_autotune(size, size, maps)));
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,97 @@
+// Image decode benchmark for the catalog loader.
+//
+// Decodes every image in the class directories of a dataset to 28x28 with
+// the original path (stb at full resolution, then resize) and with the
+// default path (libjpeg DCT-domain scaling for JPEGs when the build found
+// libjpeg), and reports images/s for each, the speedup and the mean
+// absolute pixel difference between the two outputs.
+
+#include "image_loader.h"
+#include "cnn_helper.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Best of `repeats` passes over all files; pixels receives the last pass
+static double time_decode(const std::vector<std::string> &files, DecodePath path, int repeats,
+                          std::vector<unsigned char> &pixels, int &failed) {
+    double best = 0;
+    pixels.assign(files.size() * 28 * 28, 0);
+    for (int r = 0; r < repeats; ++r) {
+        failed = 0;
+        double start = wall_seconds();
+        for (size_t f = 0; f < files.size(); ++f) {
+            if (decode_image(files[f].c_str(), InputShape(), &pixels[f * 28 * 28], path) != 0) {
+                failed++;
+            }
+        }
+        double elapsed = wall_seconds() - start;
+        if (r == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+int main(int argc, const char **argv) {
+    const char *data_dir = "data";
+    size_t max_images = 0;
+    int repeats = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        if ((strcmp(argv[i], "--data") == 0 || strcmp(argv[i], "-d") == 0) && i + 1 < argc) {
+            data_dir = argv[++i];
+        } else if ((strcmp(argv[i], "--images") == 0 || strcmp(argv[i], "-n") == 0) && i + 1 < argc) {
+            max_images = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) {
+            repeats = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [OPTIONS]\n", argv[0]);
+            printf("Options:\n");
+            printf("  --data, -d <dir>        Dataset directory (default: data)\n");
+            printf("  --images, -n <N>        Only decode the first N images (default: all)\n");
+            printf("  --repeats <N>           Passes per decoder, best is reported (default: 1)\n");
+            printf("  --help, -h              Show this help message\n");
+            return 0;
+        }
+    }
+    if (repeats < 1) {
+        repeats = 1;
+    }
+
+    std::vector<std::string> classes, files;
+    if (discover_classes(data_dir, classes) != 0) {
+        return 1;
+    }
+    char dir_path[512];
+    for (size_t c = 0; c < classes.size(); ++c) {
+        snprintf(dir_path, sizeof(dir_path), "%s/%s", data_dir, classes[c].c_str());
+        list_image_files(dir_path, files);
+    }
+    if (max_images > 0 && files.size() > max_images) {
+        files.resize(max_images);
+    }
+    if (files.empty()) {
+        fprintf(stderr, "No images found in %s\n", data_dir);
+        return 1;
+    }
+
+    std::vector<unsigned char> stb_pixels, fast_pixels;
+    int stb_failed, fast_failed;
+    double stb_seconds = time_decode(files, DECODE_STB, repeats, stb_pixels, stb_failed);
+    double fast_seconds = time_decode(files, DECODE_AUTO, repeats, fast_pixels, fast_failed);
+
+    double diff = 0;
+    for (size_t i = 0; i < stb_pixels.size(); ++i) {
+        diff += abs((int)stb_pixels[i] - (int)fast_pixels[i]);
+    }
+
+    printf("decoder,images,failed,seconds,images_per_s\n");
+    printf("stb,%zu,%d,%.3f,%.1f\n", files.size(), stb_failed, stb_seconds, files.size() / stb_seconds);
+    printf("auto,%zu,%d,%.3f,%.1f\n", files.size(), fast_failed, fast_seconds, files.size() / fast_seconds);
+    printf("\nSpeedup: %.2fx, mean |pixel difference|: %.2f / 255, peak RSS %.1f MB\n",
+           stb_seconds / fast_seconds, diff / stb_pixels.size(), peak_rss_mb());
+    return 0;
+}
@@ -0,0 +1,281 @@
+// Micro-benchmark for every kernel in layer.h.
+//
+// Built as the bench_kernels target for each CNN_BACKEND (serial, openmp, simd).
+// Each kernel runs in isolation on synthetic inputs and is reported as
+// ns/call, GFLOP/s and GB/s (compulsory bytes read + written per call).
+// Output is CSV so runs of different versions can be diffed.
+
+#include "layer.h"
+#include "cnn_helper.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Synthetic tensors with the shapes network.cpp uses for 28x28 grayscale
+static const InputShape shape;
+static float in_input[28][28];
+static float c1_preact[6][24][24], c1_output[6][24][24];
+static float c1_d_output[6][24][24], c1_d_preact[6][24][24];
+static float c1_weight[6][5][5], c1_bias[6], c1_d_weight[6][5][5], c1_d_bias[6];
+static float s1_preact[6][6][6], s1_output[6][6][6];
+static float s1_d_output[6][6][6], s1_d_preact[6][6][6];
+static float s1_weight[1][4][4], s1_bias[1], s1_d_weight[1][4][4], s1_d_bias[1];
+static float f_preact[3], f_output[3], f_d_preact[3];
+static float f_weight[3 * 216], f_bias[3], f_d_weight[3 * 216], f_d_bias[3];
+static float f_m_weight[3 * 216], f_v_weight[3 * 216];
+
+// Batched forward kernels: bench_batch samples in each layout
+static const int bench_batch = 64;
+static Tensor batch_input;
+static Tensor batch_c1[3], batch_s1_in[3], batch_s1[3];
+static std::vector<float> batch_f_weight[3], batch_f_preact;
+
+static void fill(float *p, int n, unsigned int seed) {
+    for (int i = 0; i < n; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        p[i] = (float)(seed >> 8) / (float)(1u << 24) - 0.5f;
+    }
+}
+
+static void init_tensors() {
+    fill(&in_input[0][0], 28 * 28, 1);
+    fill(&c1_preact[0][0][0], 6 * 24 * 24, 2);
+    fill(&c1_output[0][0][0], 6 * 24 * 24, 3);
+    fill(&c1_d_output[0][0][0], 6 * 24 * 24, 4);
+    fill(&c1_d_preact[0][0][0], 6 * 24 * 24, 5);
+    fill(&c1_weight[0][0][0], 6 * 25, 6);
+    fill(c1_bias, 6, 7);
+    fill(&s1_preact[0][0][0], 216, 8);
+    fill(&s1_output[0][0][0], 216, 9);
+    fill(&s1_d_output[0][0][0], 216, 10);
+    fill(&s1_d_preact[0][0][0], 216, 11);
+    fill(&s1_weight[0][0][0], 16, 12);
+    fill(s1_bias, 1, 13);
+    fill(f_preact, 3, 14);
+    fill(f_output, 3, 15);
+    fill(f_d_preact, 3, 16);
+    fill(f_weight, 3 * 216, 17);
+    fill(f_bias, 3, 18);
+    fill(&c1_d_weight[0][0][0], 6 * 25, 19);
+    fill(&s1_d_weight[0][0][0], 16, 20);
+    fill(f_d_weight, 3 * 216, 21);
+
+    batch_input.resize(bench_batch, 1, 28, 28, LAYOUT_NCHW);
+    fill(batch_input.data, bench_batch * 28 * 28, 22);
+    for (int l = 0; l < 3; ++l) {
+        batch_c1[l].resize(bench_batch, 6, 24, 24, (TensorLayout)l);
+        batch_s1_in[l].resize(bench_batch, 6, 24, 24, (TensorLayout)l);
+        fill(batch_s1_in[l].data, bench_batch * (int)batch_s1_in[l].sample_size(), 23);
+        batch_s1[l].resize(bench_batch, 6, 6, 6, (TensorLayout)l);
+        fill(batch_s1[l].data, bench_batch * (int)batch_s1[l].sample_size(), 24);
+        batch_f_weight[l].resize(3 * batch_s1[l].sample_size());
+        pack_weight_f(batch_s1[l], f_weight, batch_f_weight[l].data(), 3);
+    }
+    batch_f_preact.resize(bench_batch * 3);
+    // Keep the learning rate tiny so in-place weight updates stay bounded
+    dt = 1.0E-06f;
+}
+
+struct KernelCase {
+    const char *name;
+    double flops;   // floating point operations per call
+    double bytes;   // compulsory bytes read + written per call
+    void (*run)();
+};
+
+static const double F = sizeof(float);
+
+static void run_fp_c1() { fp_c1(&in_input[0][0], &c1_preact[0][0][0], &c1_weight[0][0][0], c1_bias, shape); }
+static void run_step_c1() { apply_step_function(&c1_preact[0][0][0], &c1_output[0][0][0], 6 * 24 * 24); }
+static void run_fp_s1() { fp_s1(&c1_output[0][0][0], &s1_preact[0][0][0], &s1_weight[0][0][0], s1_bias, shape); }
+static void run_step_s1() { apply_step_function(&s1_preact[0][0][0], &s1_output[0][0][0], 216); }
+static void run_fp_preact_f() { fp_preact_f(&s1_output[0][0][0], f_preact, f_weight, 216, 3); }
+static void run_fp_bias_f() { fp_bias_f(f_preact, f_bias, 3); }
+static void run_make_error() { makeError(f_d_preact, f_output, 1, 3); }
+static void run_bp_weight_f() { bp_weight_f(f_d_weight, f_d_preact, &s1_output[0][0][0], 216, 3); }
+static void run_bp_bias_f() { bp_bias_f(f_d_bias, f_d_preact, 3); }
+static void run_bp_output_s1() { bp_output_s1(&s1_d_output[0][0][0], f_weight, f_d_preact, 216, 3); }
+static void run_bp_preact_s1() { bp_preact_s1(&s1_d_preact[0][0][0], &s1_d_output[0][0][0], &s1_preact[0][0][0], 216); }
+static void run_bp_weight_s1() { bp_weight_s1(&s1_d_weight[0][0][0], &s1_d_preact[0][0][0], &c1_output[0][0][0], shape); }
+static void run_bp_bias_s1() { bp_bias_s1(s1_d_bias, &s1_d_preact[0][0][0], 216); }
+static void run_bp_output_c1() { bp_output_c1(&c1_d_output[0][0][0], &s1_weight[0][0][0], &s1_d_preact[0][0][0], shape); }
+static void run_bp_preact_c1() { bp_preact_c1(&c1_d_preact[0][0][0], &c1_d_output[0][0][0], &c1_preact[0][0][0], 6 * 24 * 24); }
+static void run_bp_weight_c1() { bp_weight_c1(&c1_d_weight[0][0][0], &c1_d_preact[0][0][0], &in_input[0][0], shape); }
+static void run_bp_bias_c1() { bp_bias_c1(c1_d_bias, &c1_d_preact[0][0][0], shape); }
+static void run_apply_grad_c1() { apply_grad(&c1_weight[0][0][0], &c1_d_weight[0][0][0], 6 * 25); }
+static void run_apply_grad_s1() { apply_grad(&s1_weight[0][0][0], &s1_d_weight[0][0][0], 16); }
+static void run_apply_grad_f() { apply_grad(f_weight, f_d_weight, 3 * 216); }
+static void run_momentum_f() { apply_grad_momentum(f_weight, f_d_weight, f_m_weight, 3 * 216, 0.9f); }
+static void run_nesterov_f() { apply_grad_nesterov(f_weight, f_d_weight, f_m_weight, 3 * 216, 0.9f); }
+static void run_adam_f() { apply_grad_adam(f_weight, f_d_weight, f_m_weight, f_v_weight, 3 * 216, 0.9f, 0.999f, 1.0E-08f, 100); }
+
+template <int L> static void run_fp_c1_batch() {
+    fp_c1_batch(batch_input, batch_c1[L], &c1_weight[0][0][0], c1_bias);
+}
+template <int L> static void run_fp_s1_batch() {
+    fp_s1_batch(batch_s1_in[L], batch_s1[L], &s1_weight[0][0][0], s1_bias);
+}
+template <int L> static void run_fp_f_batch() {
+    fp_f_batch(batch_s1[L], batch_f_preact.data(), batch_f_weight[L].data(), f_bias, 3);
+}
+
+static const double B = bench_batch;
+
+static const KernelCase kernel_cases[] = {
+    {"fp_c1",               6 * 576 * (25 * 2 + 1),  (784 + 150 + 6 + 3456) * F,        run_fp_c1},
+    {"apply_step_c1",       3456 * 4,                (3456 * 2) * F,                    run_step_c1},
+    {"fp_s1",               216 * (16 * 2 + 1),      (3456 + 16 + 1 + 216) * F,         run_fp_s1},
+    {"apply_step_s1",       216 * 4,                 (216 * 2) * F,                     run_step_s1},
+    {"fp_preact_f",         3 * 216 * 2,             (216 + 648 + 3) * F,               run_fp_preact_f},
+    {"fp_bias_f",           3,                       (3 * 3) * F,                       run_fp_bias_f},
+    {"makeError",           3,                       (3 * 2) * F,                       run_make_error},
+    {"bp_weight_f",         3 * 216,                 (3 + 216 + 648) * F,               run_bp_weight_f},
+    {"bp_bias_f",           3 * 2,                   (3 * 3) * F,                       run_bp_bias_f},
+    {"bp_output_s1",        3 * 216 * 2,             (648 + 3 + 216) * F,               run_bp_output_s1},
+    {"bp_preact_s1",        216 * 7,                 (216 * 3) * F,                     run_bp_preact_s1},
+    {"bp_weight_s1",        16 * 216 * 2,            (216 + 3456 + 16) * F,             run_bp_weight_s1},
+    {"bp_bias_s1",          216 + 3,                 (216 + 2) * F,                     run_bp_bias_s1},
+    {"bp_output_c1",        16 * 216 * 2,            (16 + 216 + 3456) * F,             run_bp_output_c1},
+    {"bp_preact_c1",        3456 * 10,               (3456 * 3) * F,                    run_bp_preact_c1},
+    {"bp_weight_c1",        150 * 576 * 3,           (3456 + 784 + 150) * F,            run_bp_weight_c1},
+    {"bp_bias_c1",          3456 + 6 * 3,            (3456 + 12) * F,                   run_bp_bias_c1},
+    {"apply_grad_c1",       150 * 2,                 (150 * 3) * F,                     run_apply_grad_c1},
+    {"apply_grad_s1",       16 * 2,                  (16 * 3) * F,                      run_apply_grad_s1},
+    {"apply_grad_f",        648 * 2,                 (648 * 3) * F,                     run_apply_grad_f},
+    {"momentum_f",          648 * 4,                 (648 * 5) * F,                     run_momentum_f},
+    {"nesterov_f",          648 * 6,                 (648 * 5) * F,                     run_nesterov_f},
+    {"adam_f",              648 * 13,                (648 * 7) * F,                     run_adam_f},
+    {"fp_c1_batch_nchw",    B * 6 * 576 * 51,        (B * (784 + 3456) + 156) * F,      run_fp_c1_batch<LAYOUT_NCHW>},
+    {"fp_c1_batch_nhwc",    B * 6 * 576 * 51,        (B * (784 + 3456) + 156) * F,      run_fp_c1_batch<LAYOUT_NHWC>},
+    {"fp_c1_batch_nchw8c",  B * 6 * 576 * 51,        (B * (784 + 3456) + 156) * F,      run_fp_c1_batch<LAYOUT_NCHW8C>},
+    {"fp_s1_batch_nchw",    B * 216 * 33,            (B * (3456 + 216) + 17) * F,       run_fp_s1_batch<LAYOUT_NCHW>},
+    {"fp_s1_batch_nhwc",    B * 216 * 33,            (B * (3456 + 216) + 17) * F,       run_fp_s1_batch<LAYOUT_NHWC>},
+    {"fp_s1_batch_nchw8c",  B * 216 * 33,            (B * (3456 + 216) + 17) * F,       run_fp_s1_batch<LAYOUT_NCHW8C>},
+    {"fp_f_batch_nchw",     B * 3 * 217 * 2,         (B * (216 + 3) + 651) * F,         run_fp_f_batch<LAYOUT_NCHW>},
+    {"fp_f_batch_nhwc",     B * 3 * 217 * 2,         (B * (216 + 3) + 651) * F,         run_fp_f_batch<LAYOUT_NHWC>},
+    {"fp_f_batch_nchw8c",   B * 3 * 217 * 2,         (B * (216 + 3) + 651) * F,         run_fp_f_batch<LAYOUT_NCHW8C>},
+};
+static const int num_kernel_cases = sizeof(kernel_cases) / sizeof(kernel_cases[0]);
+
+// Time one kernel: warm up, then double the batch size until a batch runs
+// for at least min_seconds, and report the best of `repeats` batches.
+static double time_kernel(const KernelCase &k, double min_seconds, int repeats) {
+    for (int i = 0; i < 16; ++i) k.run();
+
+    long batch = 1;
+    for (;;) {
+        double t0 = wall_seconds();
+        for (long i = 0; i < batch; ++i) k.run();
+        double t = wall_seconds() - t0;
+        if (t >= min_seconds || batch >= (1L << 30)) break;
+        batch *= 2;
+    }
+
+    double best = 1e30;
+    for (int r = 0; r < repeats; ++r) {
+        double t0 = wall_seconds();
+        for (long i = 0; i < batch; ++i) k.run();
+        double per_call = (wall_seconds() - t0) / batch;
+        if (per_call < best) best = per_call;
+    }
+    return best;
+}
+
+static std::vector<int> parse_thread_list(const char *arg) {
+    std::vector<int> out;
+    const char *p = arg;
+    while (*p) {
+        int v = atoi(p);
+        if (v > 0) out.push_back(v);
+        const char *comma = strchr(p, ',');
+        if (!comma) break;
+        p = comma + 1;
+    }
+    return out;
+}
+
+int main(int argc, const char **argv) {
+    std::vector<int> thread_counts;
+    double min_seconds = 0.05;
+    int repeats = 5;
+    const char *filter = nullptr;
+    const char *csv_path = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc) {
+            thread_counts = parse_thread_list(argv[++i]);
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) {
+            repeats = atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "--kernel") == 0 || strcmp(argv[i], "-k") == 0) && i + 1 < argc) {
+            filter = argv[++i];
+        } else if ((strcmp(argv[i], "--csv") == 0 || strcmp(argv[i], "-o") == 0) && i + 1 < argc) {
+            csv_path = argv[++i];
+        } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [OPTIONS]\n", argv[0]);
+            printf("Options:\n");
+            printf("  -t, --threads <list>    Comma separated thread counts (OpenMP build only, e.g. 1,2,4,8)\n");
+            printf("  -k, --kernel <name>     Only run kernels whose name contains <name>\n");
+            printf("  --min-time <seconds>    Minimum time per measured batch (default: 0.05)\n");
+            printf("  --repeats <N>           Measured batches per kernel, best is reported (default: 5)\n");
+            printf("  -o, --csv <file>        Append CSV rows to <file> instead of stdout\n");
+            printf("  --help, -h              Show this help message\n");
+            return 0;
+        }
+    }
+
+    if (thread_counts.empty()) {
+#ifdef _OPENMP
+        thread_counts.push_back(omp_get_max_threads());
+#else
+        thread_counts.push_back(1);
+#endif
+    }
+
+    FILE *csv = stdout;
+    bool write_header = true;
+    if (csv_path) {
+        FILE *probe = fopen(csv_path, "r");
+        if (probe) {
+            write_header = fgetc(probe) == EOF;
+            fclose(probe);
+        }
+        csv = fopen(csv_path, "a");
+        if (!csv) {
+            fprintf(stderr, "Failed to open %s for writing\n", csv_path);
+            return 1;
+        }
+    }
+
+    init_tensors();
+
+    if (write_header) {
+        fprintf(csv, "backend,threads,kernel,ns_per_call,gflops,gbps\n");
+    }
+    for (size_t t = 0; t < thread_counts.size(); ++t) {
+#ifdef _OPENMP
+        omp_set_num_threads(thread_counts[t]);
+#else
+        if (thread_counts[t] != 1) {
+            fprintf(stderr, "Warning: " CNN_BACKEND_NAME " build ignores thread count %d\n", thread_counts[t]);
+            continue;
+        }
+#endif
+        for (int k = 0; k < num_kernel_cases; ++k) {
+            const KernelCase &kc = kernel_cases[k];
+            if (filter && !strstr(kc.name, filter)) continue;
+            double sec = time_kernel(kc, min_seconds, repeats);
+            fprintf(csv, "%s,%d,%s,%.1f,%.4f,%.4f\n", CNN_BACKEND_NAME, thread_counts[t], kc.name,
+                    sec * 1e9, kc.flops / sec * 1e-9, kc.bytes / sec * 1e-9);
+            fflush(csv);
+        }
+    }
+
+    if (csv != stdout) fclose(csv);
+    return 0;
+}
@@ -0,0 +1,160 @@
+// Finite-difference check of the layer graph's backward passes.
+//
+// Builds small graphs that cover every module (multi-channel conv, learned
+// pooling, max pooling, fully connected, sigmoid, relu) and both output
+// heads, and compares each parameter gradient of Graph::backward with
+// central differences of the loss. The heads' losses are the ones their
+// gradients descend: cross-entropy of the softmax, and the summed binary
+// cross-entropy of the sigmoid outputs (makeError is its gradient at the
+// final sigmoid's input). Gradients are descent directions and keep the
+// fixed network's normalizations: conv weights and biases are divided by
+// the output plane, the pooling bias by all outputs.
+//
+// Prints the relative difference per parameter tensor and exits non-zero
+// when one exceeds the tolerance.
+
+#include "graph.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+struct GradCase {
+    const char *name;
+    InputShape shape;
+    const char *config;
+};
+
+static const GradCase cases[] = {
+    {"softmax, relu, maxpool, 2 convs", InputShape(12, 3),
+     "conv 4 3\nrelu\nmaxpool 2\nconv 5 3\nsigmoid\nfc 6\nrelu\nfc classes\nsoftmax\n"},
+    {"sigmoid head, learned pooling", InputShape(12, 1),
+     "conv 3 5\nsigmoid\npool 2\nsigmoid\nfc classes\nsigmoid\n"},
+    {"deep.cfg", InputShape(28, 1),
+     "conv 8 5\nrelu\nmaxpool 2\nconv 16 5\nrelu\nmaxpool 2\nfc 64\nsigmoid\nfc classes\nsigmoid\n"},
+};
+
+static void fill(float *p, size_t n, unsigned int seed) {
+    for (size_t i = 0; i < n; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        p[i] = (float)(seed >> 8) / (float)(1u << 24);
+    }
+}
+
+// The loss whose descent direction Graph::backward returns
+static double loss(Graph &graph, const float *input, unsigned int label) {
+    graph.forward(input);
+    const float *scores = graph.scores();
+    if (graph.head == HEAD_SOFTMAX) {
+        return -log((double)scores[label]);
+    }
+    double sum = 0;
+    for (int i = 0; i < graph.num_classes(); ++i) {
+        double o = scores[i];
+        sum -= i == (int)label ? log(o) : log(1 - o);
+    }
+    return sum;
+}
+
+// Normalization of a module's parameter gradient (see the header comment)
+static double grad_scale(const Module *m, bool is_bias) {
+    if (m->kind == MOD_CONV) {
+        return 1.0 / (m->out.h * m->out.w);
+    }
+    if (m->kind == MOD_POOL && is_bias) {
+        return 1.0 / m->out.size();
+    }
+    return 1.0;
+}
+
+// |analytic - numeric| / |numeric| (L2 norms) over at most `samples` evenly
+// spaced entries of param. A norm rather than the largest entry keeps the
+// few entries whose step crosses a relu or max pooling kink from failing
+// the check; a wrong gradient is off by the order of the gradient itself.
+static double check_param(Graph &graph, const float *input, unsigned int label, const Module *m, const Param &param,
+                          bool is_bias, int samples, double eps) {
+    std::vector<float> analytic(param.grad, param.grad + param.n);
+    int step = param.n > samples ? param.n / samples : 1;
+    double diff = 0, norm = 1e-12;
+    for (int i = 0; i < param.n; i += step) {
+        float saved = param.value[i];
+        param.value[i] = saved + (float)eps;
+        double plus = loss(graph, input, label);
+        param.value[i] = saved - (float)eps;
+        double minus = loss(graph, input, label);
+        param.value[i] = saved;
+        double numeric = -(plus - minus) / (2 * eps) * grad_scale(m, is_bias);
+        diff += (analytic[i] - numeric) * (analytic[i] - numeric);
+        norm += numeric * numeric;
+    }
+    return sqrt(diff / norm);
+}
+
+int main(int argc, const char **argv) {
+    double tolerance = 2e-2, eps = 1e-3;
+    int samples = 64;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--eps") == 0 && i + 1 < argc) {
+            eps = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [OPTIONS]\n", argv[0]);
+            printf("Options:\n");
+            printf("  --tolerance <F>         Largest relative difference accepted (default: 0.02)\n");
+            printf("  --eps <F>               Finite difference step (default: 0.001)\n");
+            printf("  --samples <N>           Entries checked per parameter tensor (default: 64)\n");
+            printf("  --help, -h              Show this help message\n");
+            return 0;
+        }
+    }
+    if (samples < 1) {
+        samples = 1;
+    }
+
+    std::vector<std::string> classes;
+    classes.push_back("a");
+    classes.push_back("b");
+    classes.push_back("c");
+    classes.push_back("d");
+
+    int failures = 0;
+    printf("case,module,param,rel_diff,result\n");
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+        const GradCase &gc = cases[c];
+        Graph graph;
+        if (!graph.build(gc.config, gc.name, gc.shape, classes)) {
+            return 1;
+        }
+        graph.init_weights(1 + c);
+        std::vector<float> input(gc.shape.pixels());
+        fill(&input[0], input.size(), 7 + c);
+        unsigned int label = c % classes.size();
+
+        graph.forward(&input[0]);
+        graph.backward(label);
+        for (size_t k = 0; k < graph.modules.size(); ++k) {
+            const Module *m = graph.modules[k];
+            const Param *params[] = {&m->weight, &m->bias};
+            for (int p = 0; p < 2; ++p) {
+                if (params[p]->n == 0) {
+                    continue;
+                }
+                double diff = check_param(graph, &input[0], label, m, *params[p], p == 1, samples, eps);
+                bool ok = diff <= tolerance;
+                failures += !ok;
+                printf("%s,%s,%s,%.2e,%s\n", gc.name, m->describe().c_str(), p ? "bias" : "weight", diff,
+                       ok ? "ok" : "FAIL");
+            }
+        }
+    }
+    if (failures) {
+        fprintf(stderr, "%d parameter tensors differ from finite differences by more than %g\n", failures, tolerance);
+        return 1;
+    }
+    return 0;
+}
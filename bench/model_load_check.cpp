@@ -0,0 +1,125 @@
+// Truncated model files must not change the network they are loaded into.
+//
+// Saves a 48x48 two-class adam model, then loads every interesting prefix
+// of it (header only, inside the weights, inside the optimizer trailer, one
+// byte short) into a 28x28 four-class network. Each load has to fail and
+// leave the network's shape, classes, head and weights as they were; the
+// full file has to load with the stored shape and classes.
+//
+// Prints one line per prefix and exits non-zero on the first mismatch.
+
+#include "network.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static std::vector<std::string> names(const char *const *list, int n) {
+    return std::vector<std::string>(list, list + n);
+}
+
+static bool write_file(const char *path, const std::vector<char> &bytes, size_t len) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(bytes.data(), 1, len, file) == len;
+    return fclose(file) == 0 && ok;
+}
+
+static bool read_file(const char *path, std::vector<char> &bytes) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        bytes.insert(bytes.end(), buf, buf + n);
+    }
+    fclose(file);
+    return true;
+}
+
+static bool same_weights(const Layer &a, const Layer &b) {
+    return a.M == b.M && a.N == b.N && a.O == b.O &&
+           memcmp(a.weight, b.weight, sizeof(float) * a.M * a.N) == 0 &&
+           memcmp(a.bias, b.bias, sizeof(float) * a.N) == 0;
+}
+
+int main(int argc, const char **argv) {
+    const char *path = "model_load_check.bin";
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--file") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [OPTIONS]\n", argv[0]);
+            printf("Options:\n");
+            printf("  --file <path>           Scratch model file (default: model_load_check.bin)\n");
+            printf("  --help, -h              Show this help message\n");
+            return 0;
+        }
+    }
+
+    static const char *const stored_names[] = {"a", "b"};
+    static const char *const target_names[] = {"Belts", "Keyboard", "Shoes", "Watch"};
+
+    Network stored(names(stored_names, 2), InputShape(48, 1));
+    stored.head = HEAD_SOFTMAX;
+    stored.optimizer.kind = OPT_ADAM;
+    stored.optimizer.step = 7;
+    stored.init_weights(3);
+    save_model(stored, path);
+
+    std::vector<char> bytes;
+    if (!read_file(path, bytes)) {
+        fprintf(stderr, "Failed to read back %s\n", path);
+        return 1;
+    }
+
+    // Byte offsets of the sections: the header ends with the class names,
+    // the trailer (tag, kind, step, moments) follows the weights
+    size_t header = 4 + 4 + 2 * sizeof(int) + sizeof(int) + 4;
+    for (int i = 0; i < 2; ++i) {
+        header += 4 + strlen(stored_names[i]);
+    }
+    const Layer *layers[] = {&stored.l_c1, &stored.l_s1, &stored.l_f};
+    size_t weights = 0;
+    for (const Layer *l : layers) {
+        weights += sizeof(float) * ((size_t)l->M * l->N + l->N);
+    }
+    size_t prefixes[] = {header, header + 40, header + weights - 4, header + weights + 6,
+                         header + weights + 200, bytes.size() - 1};
+
+    int failures = 0;
+    for (size_t len : prefixes) {
+        Network net(names(target_names, 4), InputShape());
+        Network reference(names(target_names, 4), InputShape());
+        net.init_weights(1);
+        reference.init_weights(1);
+
+        bool ok = write_file(path, bytes, len) && !load_model(net, path) &&
+                  net.shape == reference.shape && net.class_names == reference.class_names &&
+                  net.head == reference.head && net.optimizer.kind == reference.optimizer.kind &&
+                  same_weights(net.l_c1, reference.l_c1) && same_weights(net.l_s1, reference.l_s1) &&
+                  same_weights(net.l_f, reference.l_f);
+        failures += !ok;
+        printf("%zu of %zu bytes: %s\n", len, bytes.size(), ok ? "rejected, network unchanged" : "FAIL");
+    }
+
+    Network net(names(target_names, 4), InputShape());
+    bool ok = write_file(path, bytes, bytes.size()) && load_model(net, path) &&
+              net.shape == stored.shape && net.class_names == stored.class_names &&
+              net.head == HEAD_SOFTMAX && net.optimizer.kind == OPT_ADAM && net.optimizer.step == 7 &&
+              same_weights(net.l_c1, stored.l_c1) && same_weights(net.l_s1, stored.l_s1) &&
+              same_weights(net.l_f, stored.l_f);
+    failures += !ok;
+    printf("%zu of %zu bytes: %s\n", bytes.size(), bytes.size(), ok ? "loaded" : "FAIL");
+    remove(path);
+
+    if (failures) {
+        fprintf(stderr, "%d model loads did not behave\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,21 @@
+#!/bin/sh
+# Build the kernel micro-benchmark for every backend and write one CSV.
+# Usage: bench/run_kernels.sh [threads] [output.csv]
+#   threads     comma separated OpenMP thread counts (default: 1,2,4,8)
+#   output.csv  default: bench_kernels.csv
+set -e
+cd "$(dirname "$0")/.."
+
+THREADS=${1:-1,2,4,8}
+OUT=${2:-bench_kernels.csv}
+
+for preset in serial simd release; do
+    cmake --preset "$preset" > /dev/null
+    cmake --build --preset "$preset" --target bench_kernels > /dev/null
+done
+
+rm -f "$OUT"
+./build/serial/bench_kernels -t 1 -o "$OUT"
+./build/simd/bench_kernels -t 1 -o "$OUT"
+./build/release/bench_kernels -t "$THREADS" -o "$OUT"
+echo "Wrote $OUT"
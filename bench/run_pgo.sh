@@ -0,0 +1,57 @@
+#!/bin/sh
+# Profile-guided + link-time optimized build.
+#   1. build instrumented binaries (preset pgo-generate, build/pgo)
+#   2. run a representative training + inference workload to collect profiles
+#   3. rebuild the same tree with -fprofile-use and LTO (preset pgo-use)
+#   4. run the workload with the plain -O3 release build and the PGO build
+#      and report the speedup
+# Usage: bench/run_pgo.sh [epochs] [threads] [seed]
+#   epochs   training epochs of the workload (default: 3)
+#   threads  OpenMP threads (default: all)
+#   seed     shuffle/augmentation seed (default: 42)
+set -e
+cd "$(dirname "$0")/.."
+
+EPOCHS=${1:-3}
+THREADS=${2:-0}
+SEED=${3:-42}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# Runs the workload with binaries from build dir $1, prints the Throughput line
+workload() {
+    "$1/cnn_train" -t "$THREADS" --epochs "$EPOCHS" --seed "$SEED" -m "$TMP/model.bin" | grep '^Throughput'
+    "$1/cnn_infer" -t "$THREADS" -q -m "$TMP/model.bin" test/*.jpg > /dev/null
+}
+
+echo "[1/4] Building instrumented binaries..." >&2
+find build/pgo -name '*.gcda' -delete 2>/dev/null || true
+cmake --preset pgo-generate > /dev/null
+cmake --build --preset pgo-generate --target cnn_train cnn_infer > /dev/null
+
+echo "[2/4] Collecting profiles ($EPOCHS epochs, seed $SEED)..." >&2
+workload build/pgo > /dev/null
+
+echo "[3/4] Rebuilding with -fprofile-use and LTO..." >&2
+cmake --preset pgo-use > /dev/null
+cmake --build --preset pgo-use --target cnn_train cnn_infer > /dev/null
+
+echo "[4/4] Comparing against the plain -O3 release build..." >&2
+cmake --preset release > /dev/null
+cmake --build --preset release --target cnn_train cnn_infer > /dev/null
+
+numbers() {
+    sed 's/[^0-9.]\{1,\}/ /g' | awk '{print $1, $2, $3}'
+}
+set -- $(workload build/release | numbers)
+BASE_STARTUP=$1 BASE_TRAIN=$2 BASE_INFER=$3
+set -- $(workload build/pgo | numbers)
+
+awk -v bs="$BASE_STARTUP" -v bt="$BASE_TRAIN" -v bi="$BASE_INFER" \
+    -v ps="$1" -v pt="$2" -v pi="$3" 'BEGIN {
+    printf "%-20s %12s %12s %9s\n", "metric", "-O3", "PGO+LTO", "speedup"
+    printf "%-20s %12.3f %12.3f %8.2fx\n", "startup (s)", bs, ps, (ps > 0 ? bs / ps : 0)
+    printf "%-20s %12.1f %12.1f %8.2fx\n", "train samples/s", bt, pt, (bt > 0 ? pt / bt : 0)
+    printf "%-20s %12.1f %12.1f %8.2fx\n", "infer images/s", bi, pi, (bi > 0 ? pi / bi : 0)
+}' | tee bench_pgo.txt
+echo "PGO+LTO binaries are in build/pgo, report written to bench_pgo.txt" >&2
@@ -0,0 +1,54 @@
+#!/bin/sh
+# End-to-end throughput benchmark: serial vs OpenMP backend at several thread counts.
+# Trains for a fixed number of epochs with a fixed seed, tests on the held-out
+# split and prints a scaling table relative to the serial build.
+# Usage: bench/run_scaling.sh [epochs] [threads] [seed]
+#   epochs   training epochs per run (default: 5)
+#   threads  comma separated OpenMP thread counts (default: 1,2,4,8)
+#   seed     shuffle/augmentation seed (default: 42)
+set -e
+cd "$(dirname "$0")/.."
+
+EPOCHS=${1:-5}
+THREADS=${2:-1,2,4,8}
+SEED=${3:-42}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+for preset in serial release; do
+    cmake --preset "$preset" > /dev/null
+    cmake --build --preset "$preset" --target cnn_train > /dev/null
+done
+
+# Prints "startup train infer" from the Throughput line of a run
+throughput() {
+    grep '^Throughput' | sed 's/[^0-9.]\{1,\}/ /g' | awk '{print $1, $2, $3}'
+}
+
+echo "backend,threads,startup_s,train_samples_per_s,infer_images_per_s" > "$TMP/runs.csv"
+
+echo "Running serial ($EPOCHS epochs, seed $SEED)..." >&2
+set -- $(./build/serial/cnn_train --epochs "$EPOCHS" --seed "$SEED" -m "$TMP/serial.bin" | throughput)
+echo "serial,1,$1,$2,$3" >> "$TMP/runs.csv"
+
+for t in $(echo "$THREADS" | tr ',' ' '); do
+    echo "Running OpenMP with $t threads..." >&2
+    set -- $(./build/release/cnn_train -t "$t" --epochs "$EPOCHS" --seed "$SEED" -m "$TMP/omp.bin" | throughput)
+    echo "openmp,$t,$1,$2,$3" >> "$TMP/runs.csv"
+done
+
+cp "$TMP/runs.csv" bench_scaling.csv
+
+awk -F, 'NR == 2 { base_train = $4; base_infer = $5 }
+NR == 1 {
+    printf "%-11s %7s %10s %14s %14s %13s %13s %11s\n", "backend", "threads", "startup s",
+           "train samp/s", "infer img/s", "train speedup", "infer speedup", "efficiency"
+    next
+}
+{
+    st = base_train > 0 ? $4 / base_train : 0
+    si = base_infer > 0 ? $5 / base_infer : 0
+    printf "%-11s %7d %10.3f %14.1f %14.1f %12.2fx %12.2fx %10.1f%%\n", $1, $2, $3, $4, $5,
+           st, si, 100.0 * st / $2
+}' bench_scaling.csv
+echo "Raw results written to bench_scaling.csv" >&2
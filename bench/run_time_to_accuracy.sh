@@ -0,0 +1,44 @@
+#!/bin/sh
+# Time-to-target-accuracy benchmark: sigmoid head vs softmax + cross-entropy head.
+# Both runs use the same seed and build; training stops as soon as the test
+# accuracy reaches the target (checked after every epoch, not timed).
+# Usage: bench/run_time_to_accuracy.sh [target] [max_epochs] [seed]
+#   target      test accuracy in percent (default: 80)
+#   max_epochs  give up after this many epochs (default: 40)
+#   seed        shuffle/augmentation seed (default: 42)
+set -e
+cd "$(dirname "$0")/.."
+
+TARGET=${1:-80}
+EPOCHS=${2:-40}
+SEED=${3:-42}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cmake --preset release > /dev/null
+cmake --build --preset release --target cnn_train > /dev/null
+
+echo "head,target_pct,reached_pct,epochs,train_s" > "$TMP/runs.csv"
+for head in sigmoid softmax; do
+    echo "Running $head head (target $TARGET%, at most $EPOCHS epochs, seed $SEED)..." >&2
+    ./build/release/cnn_train --loss "$head" --target-accuracy "$TARGET" --epochs "$EPOCHS" \
+        --seed "$SEED" --no-test -m "$TMP/$head.bin" > "$TMP/$head.log"
+    # "Reached 81.23% accuracy (target 80.00%) after 7 epochs, 12.34 s of training"
+    line=$(grep '^Reached' "$TMP/$head.log" || true)
+    if [ -n "$line" ]; then
+        set -- $(echo "$line" | sed 's/[^0-9.]\{1,\}/ /g')
+        echo "$head,$TARGET,$1,$3,$4" >> "$TMP/runs.csv"
+    else
+        echo "$head,$TARGET,,,," >> "$TMP/runs.csv"
+    fi
+done
+
+cp "$TMP/runs.csv" bench_accuracy.csv
+
+awk -F, 'NR == 1 {
+    printf "%-8s %8s %10s %7s %9s\n", "head", "target %", "reached %", "epochs", "train s"
+    next
+}
+$3 == "" { printf "%-8s %8.2f %10s %7s %9s\n", $1, $2, "-", "-", "not reached"; next }
+{ printf "%-8s %8.2f %10.2f %7d %9.2f\n", $1, $2, $3, $4, $5 }' bench_accuracy.csv
+echo "Raw results written to bench_accuracy.csv" >&2
@@ -0,0 +1,247 @@
+#include "augment.h"
+#include "cnn_helper.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static const float PI = 3.14159265f;
+
+static const char *const op_names[AUG_NUM_OPS] = {
+    "flip", "shift", "rotate", "brightness", "contrast", "noise"
+};
+
+const char *augment_op_name(AugmentOp op) {
+    return op_names[op];
+}
+
+AugmentOptions::AugmentOptions()
+    : shift(0), rotate(0), brightness(0), contrast(0), noise(0.05f) {
+    for (int op = 0; op < AUG_NUM_OPS; ++op) {
+        prob[op] = 0;
+    }
+    prob[AUG_FLIP] = 0.5f;
+    prob[AUG_NOISE] = 0.5f;
+}
+
+bool AugmentOptions::parse(const char *spec) {
+    for (int op = 0; op < AUG_NUM_OPS; ++op) {
+        prob[op] = 0;
+    }
+    if (strcmp(spec, "none") == 0) {
+        return true;
+    }
+
+    float p = 0.5f;
+    std::string list(spec);
+    size_t pos = 0;
+    while (pos <= list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        std::string item = list.substr(pos, end - pos);
+        pos = end + 1;
+        if (item.empty()) continue;
+
+        size_t eq = item.find('=');
+        std::string name = item.substr(0, eq);
+        bool has_value = eq != std::string::npos;
+        float value = 0.0f;
+        if (has_value) {
+            // A finite, non-negative number and nothing else
+            const char *text = item.c_str() + eq + 1;
+            char *end;
+            double v = strtod(text, &end);
+            if (end == text || *end != '\0' || !std::isfinite(v) || v < 0) {
+                return false;
+            }
+            value = (float)v;
+        }
+
+        if (name == "p") {
+            if (!has_value || value > 1.0f) {
+                return false;
+            }
+            p = value;
+        } else if (name == "flip") {
+            if (has_value) {
+                return false;
+            }
+            prob[AUG_FLIP] = p;
+        } else if (name == "shift") {
+            // Whole pixels; shifts beyond the largest input clamp to its edge anyway
+            if (has_value && (value != floorf(value) || value > InputShape::max_size)) {
+                return false;
+            }
+            shift = has_value ? (int)value : 2;
+            prob[AUG_SHIFT] = p;
+        } else if (name == "rotate") {
+            rotate = has_value ? value : 10.0f;
+            prob[AUG_ROTATE] = p;
+        } else if (name == "brightness") {
+            brightness = has_value ? value : 0.1f;
+            prob[AUG_BRIGHTNESS] = p;
+        } else if (name == "contrast") {
+            contrast = has_value ? value : 0.2f;
+            prob[AUG_CONTRAST] = p;
+        } else if (name == "noise") {
+            noise = has_value ? value : 0.05f;
+            prob[AUG_NOISE] = p;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline float clamp01(float v) {
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+static void flip(float *img, int size, float *row) {
+    for (int i = 0; i < size; ++i) {
+        float *dst = img + i * size;
+        #pragma omp simd
+        for (int j = 0; j < size; ++j) {
+            row[j] = dst[size - 1 - j];
+        }
+        memcpy(dst, row, sizeof(float) * size);
+    }
+}
+
+static void shift(float *img, int size, int dx, int dy, float *src) {
+    memcpy(src, img, sizeof(float) * size * size);
+    int last = size - 1;
+    for (int i = 0; i < size; ++i) {
+        int y = i - dy;
+        y = y < 0 ? 0 : (y > last ? last : y);
+        #pragma omp simd
+        for (int j = 0; j < size; ++j) {
+            int x = j - dx;
+            x = x < 0 ? 0 : (x > last ? last : x);
+            img[i * size + j] = src[y * size + x];
+        }
+    }
+}
+
+static void rotate(float *img, int size, float degrees, float *src) {
+    memcpy(src, img, sizeof(float) * size * size);
+    const float c = cosf(degrees * PI / 180.0f), s = sinf(degrees * PI / 180.0f);
+    const float center = 0.5f * (size - 1);
+    const int last = size - 1;
+
+    for (int i = 0; i < size; ++i) {
+        float di = i - center;
+        #pragma omp simd
+        for (int j = 0; j < size; ++j) {
+            float dj = j - center;
+            // Inverse mapping: where the output pixel comes from
+            float x = center + c * dj + s * di;
+            float y = center - s * dj + c * di;
+            x = x < 0.0f ? 0.0f : (x > (float)last ? (float)last : x);
+            y = y < 0.0f ? 0.0f : (y > (float)last ? (float)last : y);
+            int x0 = (int)x, y0 = (int)y;
+            int x1 = x0 < last ? x0 + 1 : last, y1 = y0 < last ? y0 + 1 : last;
+            float fx = x - x0, fy = y - y0;
+            float top = src[y0 * size + x0] + fx * (src[y0 * size + x1] - src[y0 * size + x0]);
+            float bottom = src[y1 * size + x0] + fx * (src[y1 * size + x1] - src[y1 * size + x0]);
+            img[i * size + j] = top + fy * (bottom - top);
+        }
+    }
+}
+
+// out = (x - 0.5) * gain + 0.5 + offset, clamped; covers brightness and contrast
+static void affine_intensity(float *img, int pixels, float gain, float offset) {
+    #pragma omp simd
+    for (int k = 0; k < pixels; ++k) {
+        img[k] = clamp01((img[k] - 0.5f) * gain + 0.5f + offset);
+    }
+}
+
+static void add_noise(float *img, int pixels, BulkRng &noise, float level, float *pixel_noise) {
+    noise.fill_uniform(pixel_noise, pixels, -0.5f * level, 0.5f * level);
+    #pragma omp simd
+    for (int k = 0; k < pixels; ++k) {
+        img[k] = clamp01(img[k] + pixel_noise[k]);
+    }
+}
+
+Augmenter::Augmenter(const AugmentOptions &opts, const InputShape &shape)
+    : opts(opts), shape(shape), scratch(shape.pixels()) {
+    for (int op = 0; op < AUG_NUM_OPS; ++op) {
+        applied[op] = 0;
+        seconds[op] = 0;
+    }
+}
+
+void Augmenter::apply(float *const *images, int count, AugmentRng &rng) {
+    const int size = shape.size, plane = size * size, pixels = shape.pixels();
+    float *tmp = scratch.data();
+    for (int op = 0; op < AUG_NUM_OPS; ++op) {
+        if (opts.prob[op] <= 0) {
+            continue;
+        }
+        double start = wall_seconds();
+        for (int n = 0; n < count; ++n) {
+            if (rng.coin.uniform() >= opts.prob[op]) {
+                continue;
+            }
+            float *img = images[n];
+            // Geometric ops move every channel plane the same way
+            switch (op) {
+            case AUG_FLIP:
+                for (int c = 0; c < shape.channels; ++c) {
+                    flip(img + c * plane, size, tmp);
+                }
+                break;
+            case AUG_SHIFT: {
+                int range = 2 * opts.shift + 1;
+                int dx = (int)rng.coin.below(range) - opts.shift;
+                int dy = (int)rng.coin.below(range) - opts.shift;
+                for (int c = 0; c < shape.channels; ++c) {
+                    shift(img + c * plane, size, dx, dy, tmp);
+                }
+                break;
+            }
+            case AUG_ROTATE: {
+                float degrees = (2.0f * rng.coin.uniform() - 1.0f) * opts.rotate;
+                for (int c = 0; c < shape.channels; ++c) {
+                    rotate(img + c * plane, size, degrees, tmp);
+                }
+                break;
+            }
+            case AUG_BRIGHTNESS:
+                affine_intensity(img, pixels, 1.0f, (2.0f * rng.coin.uniform() - 1.0f) * opts.brightness);
+                break;
+            case AUG_CONTRAST:
+                affine_intensity(img, pixels, 1.0f + (2.0f * rng.coin.uniform() - 1.0f) * opts.contrast, 0.0f);
+                break;
+            case AUG_NOISE:
+                add_noise(img, pixels, rng.noise, opts.noise, tmp);
+                break;
+            }
+            applied[op]++;
+        }
+        seconds[op] += wall_seconds() - start;
+    }
+}
+
+void Augmenter::report() const {
+    unsigned long total = 0;
+    for (int op = 0; op < AUG_NUM_OPS; ++op) {
+        total += applied[op];
+    }
+    if (total == 0) {
+        return;  // augmentation never started
+    }
+
+    fprintf(stdout, "Augmentation cost per op:\n");
+    for (int op = 0; op < AUG_NUM_OPS; ++op) {
+        if (opts.prob[op] <= 0) {
+            continue;
+        }
+        fprintf(stdout, "  %-10s p=%.2f  %8lu samples  %8.3lf ms total  %7.3lf us/sample\n",
+                op_names[op], opts.prob[op], applied[op], 1000.0 * seconds[op],
+                applied[op] ? 1.0e6 * seconds[op] / applied[op] : 0.0);
+    }
+}
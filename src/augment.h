@@ -0,0 +1,65 @@
+#ifndef AUGMENT_H
+#define AUGMENT_H
+
+// On-the-fly augmentation of planar float images in [0, 1].
+//
+// Each enabled op is applied to a sample independently with its own
+// probability. Batches are processed op by op, so the inner loops of one op
+// stay hot and are vectorized with #pragma omp simd. Ops that move pixels
+// (flip, shift, rotate) move every channel plane alike; shift and rotate
+// clamp to the nearest edge pixel instead of padding.
+// Augmenter keeps per-op counts and time for the report at the end of
+// training.
+
+#include "rng.h"
+#include "input_shape.h"
+#include <vector>
+
+enum AugmentOp {
+    AUG_FLIP = 0,     // horizontal flip
+    AUG_SHIFT,        // random translation (crop + edge pad) by up to `shift` pixels
+    AUG_ROTATE,       // bilinear rotation by up to `rotate` degrees
+    AUG_BRIGHTNESS,   // add up to +-brightness
+    AUG_CONTRAST,     // scale around 0.5 by 1 +- contrast
+    AUG_NOISE,        // uniform per-pixel noise of width `noise`
+    AUG_NUM_OPS
+};
+
+struct AugmentOptions {
+    float prob[AUG_NUM_OPS];  // probability each op is applied to a sample
+    int shift;
+    float rotate;
+    float brightness;
+    float contrast;
+    float noise;
+
+    AugmentOptions();  // flip 0.5 and noise 0.05 at 0.5, everything else off
+
+    // "flip,shift=2,rotate=10,brightness=0.1,contrast=0.2,noise=0.05,p=0.5"
+    // (p sets the probability of the ops listed after it) or "none".
+    // False on an unknown op or an invalid value: not a number, negative, a
+    // fractional shift, p outside [0, 1] or a value for flip.
+    bool parse(const char *spec);
+};
+
+const char *augment_op_name(AugmentOp op);
+
+class Augmenter {
+  public:
+    Augmenter(const AugmentOptions &opts, const InputShape &shape);
+
+    // Augment `count` images of shape.pixels() floats in place
+    void apply(float *const *images, int count, AugmentRng &rng);
+
+    // Per-op counts and average cost, one line per enabled op
+    void report() const;
+
+  private:
+    AugmentOptions opts;
+    InputShape shape;
+    std::vector<float> scratch;  // one image: source plane of shift/rotate, noise
+    unsigned long applied[AUG_NUM_OPS];
+    double seconds[AUG_NUM_OPS];
+};
+
+#endif // AUGMENT_H
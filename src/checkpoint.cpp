@@ -0,0 +1,275 @@
+#include "checkpoint.h"
+#include <cstdio>
+#include <cstring>
+
+// File layout: tag, fixed-size header fields, input shape, class names, RNG
+// state, parameter count, parameters, validation state, best parameters.
+// CKP1 files had no shape or classes, CKP2 files no validation state.
+static const char checkpoint_tag[4] = {'C', 'K', 'P', '3'};
+
+Checkpoint::Checkpoint()
+    : epoch(0), total_epochs(0), seed(0), dt(0), initial_lr(0), head(HEAD_SIGMOID),
+      train_seconds(0), train_samples(0), best_accuracy(-1), best_epoch(0), bad_evals(0), best_dt(0),
+      best_step(0) {
+}
+
+// Number of floats a layer contributes to Checkpoint::params
+static size_t layer_floats(const Layer &l) {
+    return 3 * (size_t)l.M * l.N + 3 * (size_t)l.N;
+}
+
+static void append(std::vector<float> &dst, const float *src, int n) {
+    dst.insert(dst.end(), src, src + n);
+}
+
+void checkpoint_capture(const Network &net, Checkpoint &ckpt) {
+    const Layer *layers[] = {&net.l_c1, &net.l_s1, &net.l_f};
+
+    ckpt.head = net.head;
+    ckpt.optimizer = net.optimizer;
+    ckpt.class_names = net.class_names;
+    ckpt.shape = net.shape;
+    ckpt.dt = dt;
+
+    ckpt.params.clear();
+    for (const Layer *l : layers) {
+        append(ckpt.params, l->weight, l->M * l->N);
+        append(ckpt.params, l->bias, l->N);
+        append(ckpt.params, l->m_weight, l->M * l->N);
+        append(ckpt.params, l->v_weight, l->M * l->N);
+        append(ckpt.params, l->m_bias, l->N);
+        append(ckpt.params, l->v_bias, l->N);
+    }
+}
+
+bool checkpoint_restore(Network &net, const Checkpoint &ckpt) {
+    Layer *layers[] = {&net.l_c1, &net.l_s1, &net.l_f};
+
+    size_t expected = 0;
+    for (Layer *l : layers) {
+        expected += layer_floats(*l);
+    }
+    if (ckpt.params.size() != expected) {
+        return false;
+    }
+
+    const float *p = ckpt.params.data();
+    for (Layer *l : layers) {
+        float *dst[] = {l->weight, l->bias, l->m_weight, l->v_weight, l->m_bias, l->v_bias};
+        int len[] = {l->M * l->N, l->N, l->M * l->N, l->M * l->N, l->N, l->N};
+        for (int i = 0; i < 6; ++i) {
+            memcpy(dst[i], p, sizeof(float) * len[i]);
+            p += len[i];
+        }
+    }
+
+    net.head = ckpt.head;
+    net.optimizer = ckpt.optimizer;
+    dt = ckpt.dt;
+    return true;
+}
+
+void checkpoint_capture_rng(const AugmentRng &rng, Checkpoint &ckpt) {
+    ckpt.rng_state.assign((const char *)&rng, sizeof(rng));
+}
+
+bool checkpoint_restore_rng(const Checkpoint &ckpt, AugmentRng &rng) {
+    if (ckpt.rng_state.size() != sizeof(rng)) {
+        return false;
+    }
+    memcpy(&rng, ckpt.rng_state.data(), sizeof(rng));
+    return true;
+}
+
+template <typename T>
+static bool write_value(FILE *file, const T &v) {
+    return fwrite(&v, sizeof(T), 1, file) == 1;
+}
+
+template <typename T>
+static bool read_value(FILE *file, T &v) {
+    return fread(&v, sizeof(T), 1, file) == 1;
+}
+
+// Length-prefixed strings
+static bool write_strings(FILE *file, const std::vector<std::string> &list) {
+    unsigned int count = list.size();
+    bool ok = write_value(file, count);
+    for (size_t i = 0; ok && i < list.size(); ++i) {
+        unsigned int len = list[i].size();
+        ok = write_value(file, len) && fwrite(list[i].data(), 1, len, file) == len;
+    }
+    return ok;
+}
+
+static bool read_strings(FILE *file, std::vector<std::string> &list) {
+    unsigned int count;
+    if (!read_value(file, count) || count > 65536) {
+        return false;
+    }
+    list.resize(count);
+    for (size_t i = 0; i < list.size(); ++i) {
+        unsigned int len;
+        if (!read_value(file, len) || len > 4096) {
+            return false;
+        }
+        list[i].resize(len);
+        if (len > 0 && fread(&list[i][0], 1, len, file) != len) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checkpoint_write(const Checkpoint &ckpt, const char *path) {
+    std::string tmp_path = std::string(path) + ".tmp";
+    FILE *file = fopen(tmp_path.c_str(), "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open checkpoint for writing: %s\n", tmp_path.c_str());
+        return false;
+    }
+
+    int head = ckpt.head, kind = ckpt.optimizer.kind;
+    int shape[2] = {ckpt.shape.size, ckpt.shape.channels};
+    unsigned long long step = ckpt.optimizer.step, samples = ckpt.train_samples;
+    unsigned int rng_len = ckpt.rng_state.size();
+    unsigned long long count = ckpt.params.size(), best_count = ckpt.best_params.size();
+
+    bool ok = fwrite(checkpoint_tag, 1, 4, file) == 4 &&
+              write_value(file, ckpt.epoch) && write_value(file, ckpt.total_epochs) &&
+              write_value(file, ckpt.seed) && write_value(file, ckpt.dt) &&
+              write_value(file, ckpt.initial_lr) && write_value(file, head) &&
+              write_value(file, kind) && write_value(file, ckpt.optimizer.momentum) &&
+              write_value(file, ckpt.optimizer.beta1) && write_value(file, ckpt.optimizer.beta2) &&
+              write_value(file, ckpt.optimizer.eps) && write_value(file, step) &&
+              write_value(file, ckpt.train_seconds) && write_value(file, samples) &&
+              fwrite(shape, sizeof(int), 2, file) == 2 && write_strings(file, ckpt.class_names) &&
+              write_value(file, rng_len) &&
+              fwrite(ckpt.rng_state.data(), 1, rng_len, file) == rng_len &&
+              write_value(file, count) &&
+              fwrite(ckpt.params.data(), sizeof(float), count, file) == count &&
+              write_value(file, ckpt.best_accuracy) && write_value(file, ckpt.best_epoch) &&
+              write_value(file, ckpt.bad_evals) && write_value(file, ckpt.best_dt) &&
+              write_value(file, ckpt.best_step) && write_value(file, best_count) &&
+              fwrite(ckpt.best_params.data(), sizeof(float), best_count, file) == best_count;
+
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmp_path.c_str(), path) != 0) {
+        fprintf(stderr, "Failed to write checkpoint %s\n", path);
+        remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool checkpoint_read(Checkpoint &ckpt, const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    char tag[4] = {0, 0, 0, 0};
+    int head, kind, shape[2];
+    unsigned long long step, samples, count, best_count;
+    unsigned int rng_len;
+
+    if (fread(tag, 1, 4, file) != 4 || memcmp(tag, checkpoint_tag, 4) != 0) {
+        if (memcmp(tag, checkpoint_tag, 3) == 0) {
+            fprintf(stderr, "Checkpoint %s was written by an older version; start a new run\n", path);
+        } else {
+            fprintf(stderr, "Invalid checkpoint file: %s\n", path);
+        }
+        fclose(file);
+        return false;
+    }
+    bool ok = read_value(file, ckpt.epoch) && read_value(file, ckpt.total_epochs) &&
+              read_value(file, ckpt.seed) && read_value(file, ckpt.dt) &&
+              read_value(file, ckpt.initial_lr) && read_value(file, head) &&
+              read_value(file, kind) && read_value(file, ckpt.optimizer.momentum) &&
+              read_value(file, ckpt.optimizer.beta1) && read_value(file, ckpt.optimizer.beta2) &&
+              read_value(file, ckpt.optimizer.eps) && read_value(file, step) &&
+              read_value(file, ckpt.train_seconds) && read_value(file, samples) &&
+              fread(shape, sizeof(int), 2, file) == 2 && InputShape(shape[0], shape[1]).valid() &&
+              read_strings(file, ckpt.class_names) &&
+              read_value(file, rng_len) && rng_len < (1u << 16);
+    if (ok) {
+        ckpt.rng_state.resize(rng_len);
+        ok = fread(&ckpt.rng_state[0], 1, rng_len, file) == rng_len &&
+             read_value(file, count) && count < (1ull << 28);
+    }
+    if (ok) {
+        ckpt.params.resize(count);
+        ok = fread(ckpt.params.data(), sizeof(float), count, file) == count &&
+             read_value(file, ckpt.best_accuracy) && read_value(file, ckpt.best_epoch) &&
+             read_value(file, ckpt.bad_evals) && read_value(file, ckpt.best_dt) &&
+             read_value(file, ckpt.best_step) && read_value(file, best_count) &&
+             (best_count == 0 || best_count == count);
+    }
+    if (ok) {
+        ckpt.best_params.resize(best_count);
+        ok = fread(ckpt.best_params.data(), sizeof(float), best_count, file) == best_count;
+    }
+    fclose(file);
+
+    if (!ok || (head != HEAD_SIGMOID && head != HEAD_SOFTMAX) || kind < OPT_SGD || kind > OPT_ADAM) {
+        fprintf(stderr, "Invalid checkpoint file: %s\n", path);
+        return false;
+    }
+    ckpt.head = (OutputHead)head;
+    ckpt.optimizer.kind = (OptimizerKind)kind;
+    ckpt.optimizer.step = step;
+    ckpt.train_samples = samples;
+    ckpt.shape = InputShape(shape[0], shape[1]);
+    return true;
+}
+
+CheckpointWriter::CheckpointWriter(const char *path)
+    : path(path), has_pending(false), busy(false), stopping(false) {
+    worker = std::thread(&CheckpointWriter::run, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    cond.notify_all();
+    worker.join();
+}
+
+void CheckpointWriter::submit(Checkpoint &ckpt) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::swap(pending, ckpt);  // O(1): only the vector/string buffers change hands
+        has_pending = true;
+    }
+    cond.notify_all();
+}
+
+void CheckpointWriter::flush() {
+    std::unique_lock<std::mutex> guard(lock);
+    cond.wait(guard, [this] { return !has_pending && !busy; });
+}
+
+void CheckpointWriter::run() {
+    Checkpoint current;
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        cond.wait(guard, [this] { return has_pending || stopping; });
+        if (!has_pending) {
+            break;  // stopping with nothing left to write
+        }
+        std::swap(current, pending);
+        has_pending = false;
+        busy = true;
+
+        guard.unlock();
+        if (checkpoint_write(current, path.c_str())) {
+            fprintf(stdout, "Checkpoint saved to %s (epoch %d)\n", path.c_str(), current.epoch);
+        }
+        guard.lock();
+
+        busy = false;
+        cond.notify_all();
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+// Training checkpoints.
+//
+// A Checkpoint is a self-contained copy of everything learn() needs to
+// continue a run exactly where it stopped: the epoch counter, learning
+// rate, seed, augmentation RNG state, output head, optimizer settings,
+// class names, input shape, all parameters plus optimizer state and the
+// validation state (best weights, patience counter). It is captured at an epoch boundary
+// (a few KB of memcpy) and written to disk by CheckpointWriter on a
+// background thread, so training does not wait for the file system.
+
+#include "network.h"
+#include <condition_variable>
+#include <mutex>
+#include "rng.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Checkpoint {
+    int epoch;              // last completed epoch
+    int total_epochs;
+    unsigned int seed;
+    float dt;               // learning rate at the end of `epoch`
+    float initial_lr;
+    OutputHead head;
+    Optimizer optimizer;
+    std::vector<std::string> class_names;  // label -> class name; --resume needs the same list
+    InputShape shape;
+    double train_seconds;   // throughput counters so far
+    unsigned long train_samples;
+    std::string rng_state;  // augmentation RNG (raw AugmentRng bytes)
+    std::vector<float> params;  // per layer: weight, bias, m/v weight, m/v bias
+
+    // Finished validations (--val-every); a running one is collected before the capture
+    double best_accuracy;   // -1 before the first validation
+    int best_epoch;
+    int bad_evals;
+    float best_dt;          // dt and optimizer step of the best weights
+    unsigned long long best_step;
+    std::vector<float> best_params;  // same layout as params; empty before the first validation
+
+    Checkpoint();
+};
+
+// Copy parameters, head, optimizer state, classes, shape and dt into `ckpt`
+void checkpoint_capture(const Network &net, Checkpoint &ckpt);
+void checkpoint_capture_rng(const AugmentRng &rng, Checkpoint &ckpt);
+// Restore parameters, head, optimizer state and dt into `net`; false on a shape mismatch
+bool checkpoint_restore(Network &net, const Checkpoint &ckpt);
+// Restore the augmentation RNG; false if the stored state is malformed
+bool checkpoint_restore_rng(const Checkpoint &ckpt, AugmentRng &rng);
+
+// Write to `<path>.tmp` and rename over `path`, so a crash never leaves a
+// half-written checkpoint behind
+bool checkpoint_write(const Checkpoint &ckpt, const char *path);
+bool checkpoint_read(Checkpoint &ckpt, const char *path);
+
+// Background writer. submit() hands over a snapshot and returns at once; if
+// the previous snapshot is still being written, only the newest pending one
+// is kept.
+class CheckpointWriter {
+  public:
+    explicit CheckpointWriter(const char *path);
+    ~CheckpointWriter();  // writes any pending snapshot, then joins
+
+    void submit(Checkpoint &ckpt);  // takes the contents of ckpt
+    void flush();                   // wait until everything submitted is on disk
+
+  private:
+    void run();
+
+    std::string path;
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable cond;
+    Checkpoint pending;
+    bool has_pending;
+    bool busy;
+    bool stopping;
+
+    CheckpointWriter(const CheckpointWriter &);
+    CheckpointWriter &operator=(const CheckpointWriter &);
+};
+
+#endif // CHECKPOINT_H
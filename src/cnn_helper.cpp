@@ -0,0 +1,47 @@
+#include "cnn_helper.h"
+#include <cstdlib>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+int epoch_delay_ms = 0;
+
+void apply_epoch_delay() {
+    if (epoch_delay_ms <= 0) return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(epoch_delay_ms));
+}
+
+void init_epoch_delay_from_env() {
+    const char* env = std::getenv("VISUALSEARCH_DELAY_MS");
+    if (!env) return;
+    int v = atoi(env);
+    if (v > 0) epoch_delay_ms = v;
+}
+
+double wall_seconds() {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double peak_rss_mb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);  // bytes
+#else
+    return usage.ru_maxrss / 1024.0;             // KB
+#endif
+#endif
+}
@@ -15,4 +15,10 @@ void apply_epoch_delay();
 // Initialize epoch_delay_ms from the VISUALSEARCH_DELAY_MS environment variable
 void init_epoch_delay_from_env();
 
+// Monotonic wall clock in seconds (backend independent replacement for omp_get_wtime)
+double wall_seconds();
+
+// Peak resident set size of the process in MB (0 where unsupported)
+double peak_rss_mb();
+
 #endif // CNN_HELPER_H
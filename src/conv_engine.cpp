@@ -0,0 +1,417 @@
+#include "conv_engine.h"
+#include "cnn_helper.h"
+#include <complex>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+
+static const char *const engine_names[num_conv_engines + 1] = {
+    "direct", "im2col", "winograd", "fft", "auto"
+};
+
+const char *conv_engine_name(ConvEngine engine) {
+    return engine_names[engine];
+}
+
+bool parse_conv_engine(const char *name, ConvEngine &engine) {
+    for (int e = 0; e <= num_conv_engines; ++e) {
+        if (strcmp(name, engine_names[e]) == 0) {
+            engine = (ConvEngine)e;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void conv_direct(const float *input, int h, int w, float *output,
+                        const float *weight, const float *bias, int maps) {
+    int oh = h - 4, ow = w - 4;
+    #pragma omp parallel for collapse(2)
+    for (int m = 0; m < maps; ++m) {
+        for (int y = 0; y < oh; ++y) {
+            const float *wm = weight + m * 25;
+            float *out = output + ((size_t)m * oh + y) * ow;
+            #pragma omp simd
+            for (int x = 0; x < ow; ++x) {
+                float sum = 0.0f;
+                for (int i = 0; i < 5; ++i) {
+                    for (int j = 0; j < 5; ++j) {
+                        sum += input[(y + i) * w + x + j] * wm[i * 5 + j];
+                    }
+                }
+                out[x] = sum + bias[m];
+            }
+        }
+    }
+}
+
+static void conv_im2col(const float *input, int h, int w, float *output,
+                        const float *weight, const float *bias, int maps) {
+    int oh = h - 4, ow = w - 4;
+    size_t pixels = (size_t)oh * ow;
+
+    // Row k = i * 5 + j holds input[y + i][x + j] for every output pixel
+    static thread_local std::vector<float> cols;
+    cols.resize(25 * pixels);
+    for (int k = 0; k < 25; ++k) {
+        int i = k / 5, j = k % 5;
+        for (int y = 0; y < oh; ++y) {
+            memcpy(&cols[k * pixels + y * ow], input + (y + i) * w + j, sizeof(float) * ow);
+        }
+    }
+
+    // (maps x 25) x (25 x pixels), accumulated tap by tap like conv_direct.
+    // cols is thread_local, so the workers get a plain pointer to this one.
+    const float *patches = &cols[0];
+    #pragma omp parallel for
+    for (int m = 0; m < maps; ++m) {
+        float *out = output + m * pixels;
+        for (size_t p = 0; p < pixels; ++p) {
+            out[p] = 0.0f;
+        }
+        for (int k = 0; k < 25; ++k) {
+            const float *col = patches + k * pixels;
+            float wk = weight[m * 25 + k];
+            #pragma omp simd
+            for (size_t p = 0; p < pixels; ++p) {
+                out[p] += col[p] * wk;
+            }
+        }
+        for (size_t p = 0; p < pixels; ++p) {
+            out[p] += bias[m];
+        }
+    }
+}
+
+// Winograd F(2, 5) with interpolation points 0, 1, -1, 2, -2 and infinity:
+// y = AT [(G g) . (BT d)] for 6 inputs d, 5 taps g and 2 outputs y
+static const float wino_BT[6][6] = {
+    {4,  0, -5,  0, 1, 0},
+    {0, -4, -4,  1, 1, 0},
+    {0,  4, -4, -1, 1, 0},
+    {0, -2, -1,  2, 1, 0},
+    {0,  2, -1, -2, 1, 0},
+    {0,  4,  0, -5, 0, 1}
+};
+static const float wino_G[6][5] = {
+    { 1.0f / 4,  0,          0,         0,         0},
+    {-1.0f / 6, -1.0f / 6,  -1.0f / 6, -1.0f / 6, -1.0f / 6},
+    {-1.0f / 6,  1.0f / 6,  -1.0f / 6,  1.0f / 6, -1.0f / 6},
+    { 1.0f / 24, 1.0f / 12,  1.0f / 6,  1.0f / 3,  2.0f / 3},
+    { 1.0f / 24, -1.0f / 12, 1.0f / 6, -1.0f / 3,  2.0f / 3},
+    { 0,         0,          0,         0,         1}
+};
+static const float wino_AT[2][6] = {
+    {1, 1,  1, 1,  1, 0},
+    {0, 1, -1, 2, -2, 1}
+};
+
+static void conv_winograd(const float *input, int h, int w, float *output,
+                          const float *weight, const float *bias, int maps) {
+    int oh = h - 4, ow = w - 4;
+    int tiles_y = (oh + 1) / 2, tiles_x = (ow + 1) / 2;
+
+    // U[m] = G g G^T, 6x6 per map
+    static thread_local std::vector<float> U;
+    U.resize(maps * 36);
+    for (int m = 0; m < maps; ++m) {
+        const float *g = weight + m * 25;
+        float Gg[6][5];
+        for (int a = 0; a < 6; ++a) {
+            for (int j = 0; j < 5; ++j) {
+                float s = 0.0f;
+                for (int i = 0; i < 5; ++i) {
+                    s += wino_G[a][i] * g[i * 5 + j];
+                }
+                Gg[a][j] = s;
+            }
+        }
+        for (int a = 0; a < 6; ++a) {
+            for (int b = 0; b < 6; ++b) {
+                float s = 0.0f;
+                for (int j = 0; j < 5; ++j) {
+                    s += Gg[a][j] * wino_G[b][j];
+                }
+                U[m * 36 + a * 6 + b] = s;
+            }
+        }
+    }
+
+    // One row of tiles at a time, with the tile index innermost so the
+    // transforms vectorize across tiles. Tiles past the edge read zeros.
+    const float *transformed = &U[0];
+    #pragma omp parallel
+    {
+    std::vector<float> d(36 * tiles_x), t(36 * tiles_x), V(36 * tiles_x), Z(12 * tiles_x);
+    #pragma omp for
+    for (int ty = 0; ty < tiles_y; ++ty) {
+        for (int a = 0; a < 6; ++a) {
+            int y = ty * 2 + a;
+            for (int b = 0; b < 6; ++b) {
+                float *row = &d[(a * 6 + b) * tiles_x];
+                for (int tx = 0; tx < tiles_x; ++tx) {
+                    int x = tx * 2 + b;
+                    row[tx] = (y < h && x < w) ? input[y * w + x] : 0.0f;
+                }
+            }
+        }
+
+        // V = BT d B
+        for (int a = 0; a < 6; ++a) {
+            for (int b = 0; b < 6; ++b) {
+                float *tr = &t[(a * 6 + b) * tiles_x];
+                for (int tx = 0; tx < tiles_x; ++tx) {
+                    tr[tx] = 0.0f;
+                }
+                for (int k = 0; k < 6; ++k) {
+                    float c = wino_BT[a][k];
+                    if (c == 0.0f) continue;
+                    const float *dr = &d[(k * 6 + b) * tiles_x];
+                    #pragma omp simd
+                    for (int tx = 0; tx < tiles_x; ++tx) {
+                        tr[tx] += c * dr[tx];
+                    }
+                }
+            }
+        }
+        for (int a = 0; a < 6; ++a) {
+            for (int b = 0; b < 6; ++b) {
+                float *vr = &V[(a * 6 + b) * tiles_x];
+                for (int tx = 0; tx < tiles_x; ++tx) {
+                    vr[tx] = 0.0f;
+                }
+                for (int k = 0; k < 6; ++k) {
+                    float c = wino_BT[b][k];
+                    if (c == 0.0f) continue;
+                    const float *tr = &t[(a * 6 + k) * tiles_x];
+                    #pragma omp simd
+                    for (int tx = 0; tx < tiles_x; ++tx) {
+                        vr[tx] += c * tr[tx];
+                    }
+                }
+            }
+        }
+
+        for (int m = 0; m < maps; ++m) {
+            const float *u = transformed + m * 36;
+            // Z = AT (U . V), 2x6 per tile
+            for (int i = 0; i < 2; ++i) {
+                for (int b = 0; b < 6; ++b) {
+                    float *zr = &Z[(i * 6 + b) * tiles_x];
+                    for (int tx = 0; tx < tiles_x; ++tx) {
+                        zr[tx] = 0.0f;
+                    }
+                    for (int a = 0; a < 6; ++a) {
+                        float c = wino_AT[i][a] * u[a * 6 + b];
+                        if (wino_AT[i][a] == 0.0f) continue;
+                        const float *vr = &V[(a * 6 + b) * tiles_x];
+                        #pragma omp simd
+                        for (int tx = 0; tx < tiles_x; ++tx) {
+                            zr[tx] += c * vr[tx];
+                        }
+                    }
+                }
+            }
+            // Y = Z A into t (free once V is built), then the 2x2 blocks that
+            // lie inside the output
+            float *out = output + (size_t)m * oh * ow;
+            for (int i = 0; i < 2; ++i) {
+                int y = ty * 2 + i;
+                if (y >= oh) break;
+                for (int j = 0; j < 2; ++j) {
+                    float *yr = &t[j * tiles_x];
+                    for (int tx = 0; tx < tiles_x; ++tx) {
+                        yr[tx] = bias[m];
+                    }
+                    for (int b = 0; b < 6; ++b) {
+                        float c = wino_AT[j][b];
+                        if (c == 0.0f) continue;
+                        const float *zr = &Z[(i * 6 + b) * tiles_x];
+                        #pragma omp simd
+                        for (int tx = 0; tx < tiles_x; ++tx) {
+                            yr[tx] += c * zr[tx];
+                        }
+                    }
+                }
+                float *row = out + y * ow;
+                for (int x = 0; x < ow; ++x) {
+                    row[x] = t[(x & 1) * tiles_x + x / 2];
+                }
+            }
+        }
+    }
+    }
+}
+
+typedef std::complex<float> cfloat;
+
+// In-place radix-2 FFT of n = 2^k points spaced `stride` apart; twiddles
+// holds exp(-2 pi i j / n) for j < n / 2
+static void fft(cfloat *v, int n, int stride, const cfloat *twiddles, bool inverse) {
+    for (int i = 1, j = 0; i < n; ++i) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(v[i * stride], v[j * stride]);
+        }
+    }
+    for (int len = 2; len <= n; len <<= 1) {
+        int step = n / len;
+        for (int start = 0; start < n; start += len) {
+            for (int k = 0; k < len / 2; ++k) {
+                cfloat tw = inverse ? std::conj(twiddles[k * step]) : twiddles[k * step];
+                cfloat a = v[(start + k) * stride];
+                cfloat b = v[(start + k + len / 2) * stride] * tw;
+                v[(start + k) * stride] = a + b;
+                v[(start + k + len / 2) * stride] = a - b;
+            }
+        }
+    }
+}
+
+static void conv_fft(const float *input, int h, int w, float *output,
+                     const float *weight, const float *bias, int maps) {
+    int oh = h - 4, ow = w - 4;
+    int n = 8;
+    while (n < h || n < w) {
+        n <<= 1;
+    }
+    // A valid output never reads past row h - 1 or column w - 1, so the
+    // circular correlation of size n >= h, w does not wrap into it
+
+    static thread_local std::vector<cfloat> twiddles, X, K, P;
+    if ((int)twiddles.size() != n / 2) {
+        twiddles.resize(n / 2);
+        for (int k = 0; k < n / 2; ++k) {
+            twiddles[k] = std::polar(1.0f, -2.0f * 3.14159265f * k / n);
+        }
+    }
+    X.assign((size_t)n * n, cfloat(0.0f));
+    K.resize((size_t)n * n);
+    P.resize((size_t)n * n);
+
+    // Rows that are all zero stay zero, so the row pass skips them
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            X[y * n + x] = input[y * w + x];
+        }
+        fft(&X[y * n], n, 1, &twiddles[0], false);
+    }
+    for (int x = 0; x < n; ++x) {
+        fft(&X[x], n, n, &twiddles[0], false);
+    }
+
+    // Two maps per transform: the kernels go in as real and imaginary
+    // parts, and because both results are real the inverse of
+    // X conj(K_m) + i X conj(K_m+1) holds map m in its real part and map
+    // m + 1 in its imaginary part
+    float scale = 1.0f / ((float)n * n);
+    for (int m = 0; m < maps; m += 2) {
+        bool pair = m + 1 < maps;
+        std::fill(K.begin(), K.end(), cfloat(0.0f));
+        for (int i = 0; i < 5; ++i) {
+            for (int j = 0; j < 5; ++j) {
+                K[i * n + j] = cfloat(weight[m * 25 + i * 5 + j], pair ? weight[(m + 1) * 25 + i * 5 + j] : 0.0f);
+            }
+            fft(&K[i * n], n, 1, &twiddles[0], false);
+        }
+        for (int x = 0; x < n; ++x) {
+            fft(&K[x], n, n, &twiddles[0], false);
+        }
+
+        for (int fy = 0; fy < n; ++fy) {
+            for (int fx = 0; fx < n; ++fx) {
+                // Split Z = K_m + i K_m+1 using Z(-f) = conj(K_m(f)) - i conj(K_m+1(f))
+                cfloat z = K[fy * n + fx];
+                cfloat zr = std::conj(K[((n - fy) % n) * n + (n - fx) % n]);
+                cfloat km = 0.5f * (z + zr);
+                cfloat km1 = cfloat(0.0f, -0.5f) * (z - zr);
+                cfloat x = X[fy * n + fx];
+                P[fy * n + fx] = x * std::conj(km) + cfloat(0.0f, 1.0f) * (x * std::conj(km1));
+            }
+        }
+
+        // Only the first oh rows are needed after the column pass
+        for (int x = 0; x < n; ++x) {
+            fft(&P[x], n, n, &twiddles[0], true);
+        }
+        for (int y = 0; y < oh; ++y) {
+            fft(&P[y * n], n, 1, &twiddles[0], true);
+            float *out = output + ((size_t)m * oh + y) * ow;
+            float *out1 = pair ? out + (size_t)oh * ow : nullptr;
+            for (int x = 0; x < ow; ++x) {
+                cfloat v = P[y * n + x] * scale;
+                out[x] = v.real() + bias[m];
+                if (pair) {
+                    out1[x] = v.imag() + bias[m + 1];
+                }
+            }
+        }
+    }
+}
+
+void conv5x5(ConvEngine engine, const float *input, int h, int w, float *output,
+             const float *weight, const float *bias, int maps) {
+    if (engine == CONV_AUTO) {
+        engine = conv_autotune(h, w, maps);
+    }
+    switch (engine) {
+    case CONV_IM2COL: conv_im2col(input, h, w, output, weight, bias, maps); break;
+    case CONV_WINOGRAD: conv_winograd(input, h, w, output, weight, bias, maps); break;
+    case CONV_FFT: conv_fft(input, h, w, output, weight, bias, maps); break;
+    default: conv_direct(input, h, w, output, weight, bias, maps); break;
+    }
+}
+
+ConvEngine conv_autotune(int h, int w, int maps) {
+    static std::mutex lock;
+    static std::map<long long, ConvEngine> chosen;
+    long long key = ((long long)h << 40) | ((long long)w << 20) | maps;
+
+    std::lock_guard<std::mutex> guard(lock);
+    std::map<long long, ConvEngine>::iterator it = chosen.find(key);
+    if (it != chosen.end()) {
+        return it->second;
+    }
+
+    std::vector<float> input((size_t)h * w), output((size_t)maps * (h - 4) * (w - 4));
+    std::vector<float> weight(maps * 25), bias(maps);
+    unsigned int seed = 1;
+    for (size_t i = 0; i < input.size(); ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        input[i] = (float)(seed >> 8) / (float)(1u << 24);
+    }
+    for (int i = 0; i < maps * 25; ++i) {
+        weight[i] = 0.5f - (float)(i % 7) / 7.0f;
+    }
+
+    // Best of 3 runs of about 2 ms each
+    ConvEngine best = CONV_DIRECT;
+    double best_seconds = 0;
+    for (int e = 0; e < num_conv_engines; ++e) {
+        conv5x5((ConvEngine)e, &input[0], h, w, &output[0], &weight[0], &bias[0], maps);
+        double per_call = 0;
+        for (int r = 0; r < 3; ++r) {
+            int calls = 0;
+            double start = wall_seconds(), elapsed;
+            do {
+                conv5x5((ConvEngine)e, &input[0], h, w, &output[0], &weight[0], &bias[0], maps);
+                calls++;
+                elapsed = wall_seconds() - start;
+            } while (elapsed < 2.0E-03);
+            if (r == 0 || elapsed / calls < per_call) {
+                per_call = elapsed / calls;
+            }
+        }
+        if (e == 0 || per_call < best_seconds) {
+            best = (ConvEngine)e;
+            best_seconds = per_call;
+        }
+    }
+    chosen[key] = best;
+    return best;
+}
@@ -0,0 +1,34 @@
+#ifndef CONV_ENGINE_H
+#define CONV_ENGINE_H
+
+// Convolution engines for the first layer on inputs larger than 28x28.
+//
+// Every engine computes the valid 5x5 cross-correlation of fp_c1 from one
+// h x w input plane into `maps` output planes of (h - 4) x (w - 4):
+//   output[m][y][x] = bias[m] + sum_ij input[y + i][x + j] * weight[m][i][j]
+// Direct and im2col sum the taps in the same order as fp_c1 and give the
+// same floats; Winograd and FFT reassociate and differ by rounding.
+
+enum ConvEngine {
+    CONV_DIRECT = 0,    // the fp_c1 loops for any size
+    CONV_IM2COL = 1,    // 25 x pixels patch matrix times the maps x 25 weights
+    CONV_WINOGRAD = 2,  // F(2x2, 5x5): 36 multiplies per 2x2 outputs and map instead of 100
+    CONV_FFT = 3,       // pointwise product of 2D FFTs padded to a power of two
+    CONV_AUTO = 4       // fastest engine for the shape, see conv_autotune
+};
+const static int num_conv_engines = 4;  // excluding CONV_AUTO
+
+const char *conv_engine_name(ConvEngine engine);
+// "direct", "im2col", "winograd", "fft" or "auto"
+bool parse_conv_engine(const char *name, ConvEngine &engine);
+
+// weight is [maps][5][5], output [maps][h - 4][w - 4]
+void conv5x5(ConvEngine engine, const float *input, int h, int w, float *output,
+             const float *weight, const float *bias, int maps);
+
+// Time every engine on a synthetic input of this shape and return the
+// fastest. The first call for a shape measures (a few ms); later calls
+// return the cached choice.
+ConvEngine conv_autotune(int h, int w, int maps);
+
+#endif // CONV_ENGINE_H
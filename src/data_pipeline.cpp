@@ -0,0 +1,165 @@
+#include "data_pipeline.h"
+#include "cnn_helper.h"
+#include <algorithm>
+#include <cstring>
+
+DataPipeline::DataPipeline(const image_data *set, const InputShape &shape, int batch_size, bool async, unsigned int seed,
+                           const AugmentOptions &augment_opts, ShardStream *stream, const ByteImages *bytes)
+    : prepare_seconds(0), stall_seconds(0), set(set), stream(stream), bytes(bytes), shape(shape),
+      batch_size(batch_size > 0 ? batch_size : 1), async(async), aug_rng(seed), aug(augment_opts, shape),
+      slots(async ? 2 : 1), total(0), augment(false), next_index(0),
+      head(0), tail(0), ready(0), filling(false), holding(false), stopping(false) {
+    for (SampleBatch &slot : slots) {
+        slot.count = 0;
+        slot.samples.resize(this->batch_size);
+        slot.pixels.resize((size_t)this->batch_size * shape.pixels());
+    }
+    if (async) {
+        worker = std::thread(&DataPipeline::run, this);
+    }
+}
+
+DataPipeline::~DataPipeline() {
+    if (async) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        cond.notify_all();
+        worker.join();
+    }
+}
+
+void DataPipeline::begin_epoch(const std::vector<int> &epoch_order, bool epoch_augment) {
+    std::lock_guard<std::mutex> guard(lock);
+    order = epoch_order;
+    total = order.size();
+    augment = epoch_augment;
+    next_index = 0;
+    head = tail = ready = 0;
+    holding = false;
+    cond.notify_all();
+}
+
+void DataPipeline::begin_stream_epoch(unsigned int shuffle_seed, bool epoch_augment) {
+    std::lock_guard<std::mutex> guard(lock);
+    stream->begin_epoch(shuffle_seed);
+    total = stream->count();
+    augment = epoch_augment;
+    next_index = 0;
+    head = tail = ready = 0;
+    holding = false;
+    cond.notify_all();
+}
+
+// Convert to float, then augment the whole batch op by op. In-memory
+// images that are not augmented are used in place.
+void DataPipeline::fill(SampleBatch &batch, size_t first, size_t count) {
+    double start = wall_seconds();
+    float *images[256];
+
+    for (size_t s = 0; s < count; ++s) {
+        PreparedSample &dst = batch.samples[s];
+        float *pixels = &batch.pixels[s * shape.pixels()];
+        dst.data = pixels;
+        if (stream) {
+            // Batches are filled in order, so the stream is read sequentially
+            ShardRecord record;
+            if (!stream->next(record)) {
+                count = s;  // fewer records than the shard headers promised
+                break;
+            }
+            for (int i = 0; i < 28 * 28; ++i) {
+                pixels[i] = record.pixels[i] / 255.0f;
+            }
+            dst.label = record.label;
+            continue;
+        }
+        if (bytes) {
+            size_t index = order[first + s];
+            const uint8_t *src = bytes->pixels + index * 28 * 28;
+            for (int i = 0; i < 28 * 28; ++i) {
+                pixels[i] = src[i] / 255.0f;
+            }
+            dst.label = bytes->labels[index];
+            continue;
+        }
+        const image_data &src = set[order[first + s]];
+        if (augment) {
+            memcpy(pixels, src.data, sizeof(float) * shape.pixels());
+        } else {
+            dst.data = src.data;
+        }
+        dst.label = src.label;
+    }
+
+    if (augment) {
+        for (size_t s = 0; s < count; s += 256) {
+            int n = (int)std::min((size_t)256, count - s);
+            for (int k = 0; k < n; ++k) {
+                images[k] = &batch.pixels[(s + k) * shape.pixels()];
+            }
+            aug.apply(images, n, aug_rng);
+        }
+    }
+    batch.count = count;
+    prepare_seconds += wall_seconds() - start;
+}
+
+const SampleBatch *DataPipeline::next() {
+    if (!async) {
+        size_t count = std::min((size_t)batch_size, total - next_index);
+        if (count == 0) {
+            return nullptr;
+        }
+        fill(slots[0], next_index, count);
+        next_index += count;
+        return &slots[0];
+    }
+
+    std::unique_lock<std::mutex> guard(lock);
+    if (holding) {
+        holding = false;
+        head = (head + 1) % slots.size();
+        cond.notify_all();
+    }
+
+    double start = wall_seconds();
+    cond.wait(guard, [this] { return ready > 0 || (!filling && next_index >= total); });
+    stall_seconds += wall_seconds() - start;
+
+    if (ready == 0) {
+        return nullptr;
+    }
+    ready--;
+    holding = true;
+    return &slots[head];
+}
+
+void DataPipeline::run() {
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        // A slot is free unless it is ready or still read by the consumer
+        cond.wait(guard, [this] {
+            return stopping ||
+                   (next_index < total && ready + (holding ? 1 : 0) < (int)slots.size());
+        });
+        if (stopping) {
+            break;
+        }
+        SampleBatch &slot = slots[tail];
+        size_t first = next_index;
+        size_t count = std::min((size_t)batch_size, total - first);
+        next_index += count;
+        filling = true;
+
+        guard.unlock();
+        fill(slot, first, count);
+        guard.lock();
+
+        tail = (tail + 1) % slots.size();
+        ready++;
+        filling = false;
+        cond.notify_all();
+    }
+}
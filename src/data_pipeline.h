@@ -0,0 +1,98 @@
+#ifndef DATA_PIPELINE_H
+#define DATA_PIPELINE_H
+
+// Double-buffered training data pipeline.
+//
+// A producer thread walks the epoch's shuffled order, applies the random
+// augmentation and converts each sample to float into a ring of batch
+// slots, while the training thread consumes the previous slot. Samples of
+// the in-memory set that are not augmented are not copied: they point at
+// the set's images. The producer owns the augmentation RNG, so the
+// sequence of random numbers (and the trained weights) is the same as with
+// synchronous preparation. The producer never runs ahead into the next
+// epoch, which keeps the RNG state well defined at epoch boundaries for
+// checkpoints.
+
+#include "image_loader.h"
+#include "augment.h"
+#include "rng.h"
+#include "shard_stream.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct PreparedSample {
+    // shape.pixels() floats: the in-memory image itself when the epoch is
+    // not augmented, otherwise in the batch's pixel buffer
+    const float *data;
+    unsigned int label;
+};
+
+struct SampleBatch {
+    int count;
+    std::vector<PreparedSample> samples;
+    std::vector<float> pixels;  // batch size x shape.pixels()
+};
+
+class DataPipeline {
+  public:
+    // async = false prepares each batch on the calling thread inside next().
+    // With a stream (streaming mode) samples are read from it instead of set;
+    // with bytes (MNIST) the epoch order indexes the 8-bit images instead.
+    // Stream and MNIST samples are 28x28 grayscale, so shape must be too.
+    DataPipeline(const image_data *set, const InputShape &shape, int batch_size, bool async, unsigned int seed,
+                 const AugmentOptions &augment_opts, ShardStream *stream = nullptr,
+                 const ByteImages *bytes = nullptr);
+    ~DataPipeline();
+
+    // Start producing the samples of `order`; augment enables the augmentation ops
+    void begin_epoch(const std::vector<int> &order, bool augment);
+    // Streaming mode: restart the stream, shuffled from shuffle_seed
+    void begin_stream_epoch(unsigned int shuffle_seed, bool augment);
+    // Next prepared batch, or nullptr once the epoch is exhausted. The batch
+    // stays valid until the following call.
+    const SampleBatch *next();
+
+    // Augmentation RNG; only touch it between epochs
+    AugmentRng &rng() { return aug_rng; }
+    // Per-op augmentation cost; only read it between epochs
+    const Augmenter &augmenter() const { return aug; }
+
+    double prepare_seconds;  // time spent augmenting and converting
+    double stall_seconds;    // time the training thread waited for data
+
+  private:
+    void fill(SampleBatch &batch, size_t first, size_t count);
+    void run();
+
+    const image_data *set;
+    ShardStream *stream;
+    const ByteImages *bytes;
+    InputShape shape;
+    int batch_size;
+    bool async;
+    AugmentRng aug_rng;
+    Augmenter aug;
+
+    std::vector<SampleBatch> slots;
+    std::vector<int> order;
+    size_t total;       // samples in this epoch
+    bool augment;
+    size_t next_index;  // first sample not yet claimed by the producer
+    int head;           // slot the consumer reads next
+    int tail;           // slot the producer fills next
+    int ready;          // filled slots not yet consumed
+    bool filling;       // producer is working on a slot
+    bool holding;       // consumer still uses slots[head]
+    bool stopping;
+
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable cond;
+
+    DataPipeline(const DataPipeline &);
+    DataPipeline &operator=(const DataPipeline &);
+};
+
+#endif // DATA_PIPELINE_H
@@ -0,0 +1,829 @@
+#include "graph.h"
+#include "cnn_helper.h"
+#include "data_pipeline.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <random>
+
+// Model file header magic of a graph; fixed network files start with "VSCN"
+static const char graph_magic[4] = {'V', 'S', 'C', 'G'};
+static const unsigned int graph_version = 1;
+
+// Valid kernel x kernel convolution of every input map into each output map,
+// weights [maps][channels][kernel][kernel]. Sums in fp_c1's order: the taps
+// of one channel, channel by channel, then the bias.
+class ConvModule : public Module {
+  public:
+    int kernel;
+
+    ConvModule(const MapShape &in, int maps, int kernel)
+        : Module(MOD_CONV, in, MapShape(maps, in.h - kernel + 1, in.w - kernel + 1)), kernel(kernel) {
+        weight.n = maps * in.c * kernel * kernel;
+        bias.n = maps;
+    }
+
+    void forward(const float *input, float *output) {
+        // The common kernel sizes get unrolled tap loops
+        switch (kernel) {
+        case 3: conv_forward<3>(input, output); break;
+        case 5: conv_forward<5>(input, output); break;
+        default: conv_forward<0>(input, output); break;
+        }
+    }
+
+    void backward(const float *input, const float *output, const float *d_output, float *d_input) {
+        const int channels = in.c, width = in.w, oh = out.h, ow = out.w, k = kernel;
+        const int plane = oh * ow;
+        const float *w = weight.value;
+        float *dw = weight.grad, *db = bias.grad;
+        float d = (float)plane;  // Normalization factor, as in bp_weight_c1
+
+        // Each weight owns its accumulator
+        #pragma omp parallel for collapse(4)
+        for (int m = 0; m < out.c; ++m) {
+            for (int c = 0; c < channels; ++c) {
+                for (int i = 0; i < k; ++i) {
+                    for (int j = 0; j < k; ++j) {
+                        float sum = 0.0f;
+                        for (int x = 0; x < oh; ++x) {
+                            const float *dp = d_output + ((size_t)m * oh + x) * ow;
+                            const float *p = input + ((size_t)c * in.h + x + i) * width + j;
+                            #pragma omp simd reduction(+:sum)
+                            for (int y = 0; y < ow; ++y) {
+                                sum += dp[y] * p[y] / d;
+                            }
+                        }
+                        dw[((m * channels + c) * k + i) * k + j] = sum;
+                    }
+                }
+            }
+        }
+
+        #pragma omp parallel for
+        for (int m = 0; m < out.c; ++m) {
+            const float *dp = d_output + (size_t)m * plane;
+            float sum = 0.0f;
+            #pragma omp simd reduction(+:sum)
+            for (int j = 0; j < plane; ++j) {
+                sum += dp[j];
+            }
+            db[m] = sum / d;
+        }
+
+        if (!d_input) {
+            return;
+        }
+        // Scatter each output gradient back over its window; one input map per thread
+        #pragma omp parallel for
+        for (int c = 0; c < channels; ++c) {
+            float *di = d_input + (size_t)c * in.h * width;
+            memset(di, 0, sizeof(float) * in.h * width);
+            for (int m = 0; m < out.c; ++m) {
+                for (int i = 0; i < k; ++i) {
+                    for (int j = 0; j < k; ++j) {
+                        float wv = w[((m * channels + c) * k + i) * k + j];
+                        for (int x = 0; x < oh; ++x) {
+                            const float *dp = d_output + ((size_t)m * oh + x) * ow;
+                            float *dst = di + (size_t)(x + i) * width + j;
+                            #pragma omp simd
+                            for (int y = 0; y < ow; ++y) {
+                                dst[y] += wv * dp[y];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    std::string describe() const {
+        char text[64];
+        snprintf(text, sizeof(text), "conv %dx%dx%d", out.c, kernel, kernel);
+        return text;
+    }
+
+  private:
+    template <int K>
+    void conv_forward(const float *input, float *output) {
+        const int k = K ? K : kernel;
+        const int channels = in.c, width = in.w, oh = out.h, ow = out.w;
+        const float *weights = weight.value, *b = bias.value;
+
+        #pragma omp parallel for collapse(2)
+        for (int m = 0; m < out.c; ++m) {
+            for (int x = 0; x < oh; ++x) {
+                float *o = output + ((size_t)m * oh + x) * ow;
+                for (int c = 0; c < channels; ++c) {
+                    const float *row = input + ((size_t)c * in.h + x) * width;
+                    const float *wc = weights + (size_t)(m * channels + c) * k * k;
+                    conv_channel_row<K>(o, row, wc, b[m], width, ow, k, c, channels);
+                }
+            }
+        }
+    }
+};
+
+// Learned k x k subsampling: one kernel and one bias shared by all maps
+// (fp_s1 / bp_weight_s1 for any size)
+class PoolModule : public Module {
+  public:
+    int k;
+
+    PoolModule(const MapShape &in, int k) : Module(MOD_POOL, in, MapShape(in.c, in.h / k, in.w / k)), k(k) {
+        weight.n = k * k;
+        bias.n = 1;
+    }
+
+    void forward(const float *input, float *output) {
+        const int width = in.w, oh = out.h, ow = out.w;
+        const float *w = weight.value;
+        float b = bias.value[0];
+
+        #pragma omp parallel for collapse(2)
+        for (int m = 0; m < out.c; ++m) {
+            for (int x = 0; x < oh; ++x) {
+                for (int y = 0; y < ow; ++y) {
+                    float sum = 0.0f;
+                    for (int i = 0; i < k; ++i) {
+                        for (int j = 0; j < k; ++j) {
+                            sum += w[i * k + j] * input[((size_t)m * in.h + x * k + i) * width + y * k + j];
+                        }
+                    }
+                    output[((size_t)m * oh + x) * ow + y] = sum + b;
+                }
+            }
+        }
+    }
+
+    void backward(const float *input, const float *output, const float *d_output, float *d_input) {
+        const int width = in.w, oh = out.h, ow = out.w;
+        const float *w = weight.value;
+        float *dw = weight.grad;
+
+        #pragma omp parallel for collapse(2)
+        for (int i = 0; i < k; ++i) {
+            for (int j = 0; j < k; ++j) {
+                float sum = 0.0f;
+                for (int m = 0; m < out.c; ++m) {
+                    for (int x = 0; x < oh; ++x) {
+                        const float *dp = d_output + ((size_t)m * oh + x) * ow;
+                        const float *p = input + ((size_t)m * in.h + x * k + i) * width + j;
+                        #pragma omp simd reduction(+:sum)
+                        for (int y = 0; y < ow; ++y) {
+                            sum += dp[y] * p[y * k];
+                        }
+                    }
+                }
+                dw[i * k + j] = sum;
+            }
+        }
+        bp_bias_s1(bias.grad, d_output, out.size());
+
+        if (!d_input) {
+            return;
+        }
+        // The windows do not overlap and cover the input (build checks h % k == 0)
+        #pragma omp parallel for collapse(2)
+        for (int m = 0; m < out.c; ++m) {
+            for (int x = 0; x < oh; ++x) {
+                const float *dp = d_output + ((size_t)m * oh + x) * ow;
+                for (int i = 0; i < k; ++i) {
+                    float *di = d_input + ((size_t)m * in.h + x * k + i) * width;
+                    for (int y = 0; y < ow; ++y) {
+                        for (int j = 0; j < k; ++j) {
+                            di[y * k + j] = w[i * k + j] * dp[y];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    std::string describe() const {
+        char text[64];
+        snprintf(text, sizeof(text), "pool %dx%d", k, k);
+        return text;
+    }
+};
+
+class MaxPoolModule : public Module {
+  public:
+    int k;
+
+    MaxPoolModule(const MapShape &in, int k) : Module(MOD_MAXPOOL, in, MapShape(in.c, in.h / k, in.w / k)), k(k) {}
+
+    void forward(const float *input, float *output) {
+        const int width = in.w, oh = out.h, ow = out.w;
+        #pragma omp parallel for collapse(2)
+        for (int m = 0; m < out.c; ++m) {
+            for (int x = 0; x < oh; ++x) {
+                for (int y = 0; y < ow; ++y) {
+                    const float *p = input + ((size_t)m * in.h + x * k) * width + y * k;
+                    float best = p[0];
+                    for (int i = 0; i < k; ++i) {
+                        for (int j = 0; j < k; ++j) {
+                            best = std::max(best, p[i * width + j]);
+                        }
+                    }
+                    output[((size_t)m * oh + x) * ow + y] = best;
+                }
+            }
+        }
+    }
+
+    // The gradient goes to the first input equal to the window's maximum
+    void backward(const float *input, const float *output, const float *d_output, float *d_input) {
+        if (!d_input) {
+            return;
+        }
+        const int width = in.w, oh = out.h, ow = out.w;
+        #pragma omp parallel for collapse(2)
+        for (int m = 0; m < out.c; ++m) {
+            for (int x = 0; x < oh; ++x) {
+                for (int y = 0; y < ow; ++y) {
+                    size_t o = ((size_t)m * oh + x) * ow + y;
+                    size_t first = ((size_t)m * in.h + x * k) * width + y * k;
+                    bool routed = false;
+                    for (int i = 0; i < k; ++i) {
+                        for (int j = 0; j < k; ++j) {
+                            size_t p = first + (size_t)i * width + j;
+                            bool hit = !routed && input[p] == output[o];
+                            d_input[p] = hit ? d_output[o] : 0.0f;
+                            routed = routed || hit;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    std::string describe() const {
+        char text[64];
+        snprintf(text, sizeof(text), "maxpool %dx%d", k, k);
+        return text;
+    }
+};
+
+// Fully connected layer, weights [units][features]; the fixed network's kernels
+class FcModule : public Module {
+  public:
+    FcModule(const MapShape &in, int units) : Module(MOD_FC, in, MapShape(units, 1, 1)) {
+        weight.n = units * in.size();
+        bias.n = units;
+    }
+
+    void forward(const float *input, float *output) {
+        fp_preact_f(input, output, weight.value, in.size(), out.c);
+        fp_bias_f(output, bias.value, out.c);
+    }
+
+    void backward(const float *input, const float *output, const float *d_output, float *d_input) {
+        bp_weight_f(weight.grad, d_output, input, in.size(), out.c);
+        bp_bias_f(bias.grad, d_output, out.c);
+        if (d_input) {
+            bp_output_s1(d_input, weight.value, d_output, in.size(), out.c);
+        }
+    }
+
+    std::string describe() const {
+        char text[64];
+        snprintf(text, sizeof(text), "fc %d->%d", in.size(), out.c);
+        return text;
+    }
+};
+
+class SigmoidModule : public Module {
+  public:
+    explicit SigmoidModule(const MapShape &in) : Module(MOD_SIGMOID, in, in) {}
+
+    void forward(const float *input, float *output) {
+        apply_step_function((float *)input, output, in.size());
+    }
+
+    void backward(const float *input, const float *output, const float *d_output, float *d_input) {
+        if (!d_input) {
+            return;
+        }
+        int n = in.size();
+        #pragma omp parallel for simd
+        for (int k = 0; k < n; ++k) {
+            float o = output[k];
+            d_input[k] = d_output[k] * o * (1 - o);
+        }
+    }
+
+    std::string describe() const { return "sigmoid"; }
+};
+
+class ReluModule : public Module {
+  public:
+    explicit ReluModule(const MapShape &in) : Module(MOD_RELU, in, in) {}
+
+    void forward(const float *input, float *output) {
+        int n = in.size();
+        #pragma omp parallel for simd
+        for (int k = 0; k < n; ++k) {
+            output[k] = input[k] > 0.0f ? input[k] : 0.0f;
+        }
+    }
+
+    void backward(const float *input, const float *output, const float *d_output, float *d_input) {
+        if (!d_input) {
+            return;
+        }
+        int n = in.size();
+        #pragma omp parallel for simd
+        for (int k = 0; k < n; ++k) {
+            d_input[k] = input[k] > 0.0f ? d_output[k] : 0.0f;
+        }
+    }
+
+    std::string describe() const { return "relu"; }
+};
+
+Graph::Graph() : head(HEAD_SIGMOID), input(nullptr), probs(nullptr) {}
+
+Graph::~Graph() {
+    release();
+}
+
+void Graph::release() {
+    for (Module *m : modules) {
+        delete m;
+    }
+    modules.clear();
+    values.clear();
+    grads.clear();
+    activations.clear();
+    parameters.clear();
+    probs = nullptr;
+}
+
+// Whitespace separated words of a config line, without the comment
+static std::vector<std::string> config_words(const std::string &line) {
+    std::vector<std::string> words;
+    std::string text = line.substr(0, line.find('#'));
+    size_t pos = 0;
+    while ((pos = text.find_first_not_of(" \t\r\n", pos)) != std::string::npos) {
+        size_t end = text.find_first_of(" \t\r\n", pos);
+        if (end == std::string::npos) end = text.size();
+        words.push_back(text.substr(pos, end - pos));
+        pos = end;
+    }
+    return words;
+}
+
+// Positive integer argument; 0 when it is missing or not a number
+static int config_int(const std::vector<std::string> &words, size_t index) {
+    if (index >= words.size()) {
+        return 0;
+    }
+    char *end;
+    long v = strtol(words[index].c_str(), &end, 10);
+    return (*end == '\0' && v > 0 && v <= 1 << 20) ? (int)v : 0;
+}
+
+bool Graph::build(const std::string &text, const char *source, const InputShape &input_shape,
+                  const std::vector<std::string> &classes) {
+    release();
+    config = text;
+    shape = input_shape;
+    class_names = classes;
+    head = HEAD_SIGMOID;
+    if (!add_modules(source)) {
+        release();
+        return false;
+    }
+
+    // Plan every buffer once: outputs and their gradients, the softmax
+    // probabilities, then weights and biases with their gradients and
+    // optimizer state
+    bool softmax = head == HEAD_SOFTMAX;
+    size_t floats = softmax ? classes.size() : 0, param_floats = 0;
+    for (Module *m : modules) {
+        floats += 2 * (size_t)m->out.size();
+        param_floats += 4 * (size_t)(m->weight.n + m->bias.n);
+    }
+    activations.assign(floats, 0.0f);
+    parameters.assign(param_floats, 0.0f);
+
+    float *a = activations.data(), *p = parameters.data();
+    for (Module *m : modules) {
+        values.push_back(a);
+        grads.push_back(a + m->out.size());
+        a += 2 * m->out.size();
+        Param *params[] = {&m->weight, &m->bias};
+        for (Param *param : params) {
+            param->value = p;
+            param->grad = p + param->n;
+            param->m = p + 2 * param->n;
+            param->v = p + 3 * param->n;
+            p += 4 * param->n;
+        }
+    }
+    probs = softmax ? a : nullptr;
+    return true;
+}
+
+// Parse config into modules and the output head
+bool Graph::add_modules(const char *source) {
+    const std::string &text = config;
+    const std::vector<std::string> &classes = class_names;
+    MapShape cur(shape.channels, shape.size, shape.size);
+    bool softmax = false;
+    size_t pos = 0;
+    int line_no = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) end = text.size();
+        std::vector<std::string> words = config_words(text.substr(pos, end - pos));
+        pos = end + 1;
+        line_no++;
+        if (words.empty()) {
+            continue;
+        }
+        const std::string &op = words[0];
+        if (softmax) {
+            fprintf(stderr, "Error: %s:%d: softmax must be the last line\n", source, line_no);
+            return false;
+        }
+
+        Module *module = nullptr;
+        size_t args = 0;
+        if (op == "conv") {
+            int maps = config_int(words, 1), kernel = config_int(words, 2);
+            args = 2;
+            if (maps > 0 && kernel > 0 && kernel <= cur.h && kernel <= cur.w) {
+                module = new ConvModule(cur, maps, kernel);
+            }
+        } else if (op == "pool" || op == "maxpool") {
+            int k = config_int(words, 1);
+            args = 1;
+            if (k > 0 && cur.h % k == 0 && cur.w % k == 0) {
+                module = op == "pool" ? (Module *)new PoolModule(cur, k) : (Module *)new MaxPoolModule(cur, k);
+            }
+        } else if (op == "fc") {
+            int units = words.size() > 1 && words[1] == "classes" ? (int)classes.size() : config_int(words, 1);
+            args = 1;
+            if (units > 0) {
+                module = new FcModule(cur, units);
+            }
+        } else if (op == "sigmoid") {
+            module = new SigmoidModule(cur);
+        } else if (op == "relu") {
+            module = new ReluModule(cur);
+        } else if (op == "softmax") {
+            softmax = true;
+            continue;
+        } else {
+            fprintf(stderr, "Error: %s:%d: unknown layer '%s' (expected conv, pool, maxpool, fc, sigmoid, relu or softmax)\n",
+                    source, line_no, op.c_str());
+            return false;
+        }
+        if (!module || words.size() != args + 1) {
+            delete module;
+            fprintf(stderr, "Error: %s:%d: invalid '%s' for %dx%dx%d input\n", source, line_no,
+                    op.c_str(), cur.c, cur.h, cur.w);
+            return false;
+        }
+        modules.push_back(module);
+        cur = module->out;
+    }
+
+    // The output head
+    if (modules.empty() || cur.size() != (int)classes.size()) {
+        fprintf(stderr, "Error: %s: the last layer has %d outputs, expected one per class (%d); end with 'fc classes'\n",
+                source, cur.size(), (int)classes.size());
+        return false;
+    }
+    if (softmax) {
+        head = HEAD_SOFTMAX;
+    } else if (modules.back()->kind != MOD_SIGMOID || modules.size() < 2) {
+        fprintf(stderr, "Error: %s: end with sigmoid or softmax\n", source);
+        return false;
+    }
+    return true;
+}
+
+void Graph::swap(Graph &other) {
+    config.swap(other.config);
+    std::swap(shape, other.shape);
+    std::swap(head, other.head);
+    std::swap(optimizer, other.optimizer);
+    class_names.swap(other.class_names);
+    modules.swap(other.modules);
+    std::swap(input, other.input);
+    values.swap(other.values);
+    grads.swap(other.grads);
+    std::swap(probs, other.probs);
+    activations.swap(other.activations);
+    parameters.swap(other.parameters);
+}
+
+void Graph::init_weights(unsigned int seed) {
+    // Layer::init_weights per module: each output's bias, then its weights
+    Rng rng(seed, RNG_STREAM_INIT);
+    for (Module *m : modules) {
+        int outputs = m->bias.n;
+        if (outputs == 0) {
+            continue;
+        }
+        int fan_in = m->weight.n / outputs;
+        for (int i = 0; i < outputs; ++i) {
+            m->bias.value[i] = 0.5f - rng.uniform();
+            for (int j = 0; j < fan_in; ++j) {
+                m->weight.value[i * fan_in + j] = 0.5f - rng.uniform();
+            }
+        }
+    }
+}
+
+size_t Graph::num_parameters() const {
+    size_t n = 0;
+    for (Module *m : modules) {
+        n += m->weight.n + m->bias.n;
+    }
+    return n;
+}
+
+void Graph::forward(const float *data) {
+    input = data;
+    const float *in = data;
+    for (size_t k = 0; k < modules.size(); ++k) {
+        double start = wall_seconds();
+        modules[k]->forward(in, values[k]);
+        modules[k]->seconds += wall_seconds() - start;
+        in = values[k];
+    }
+    if (head == HEAD_SOFTMAX) {
+        apply_softmax(values.back(), probs, num_classes());
+    }
+}
+
+float Graph::backward(unsigned int label) {
+    int classes = num_classes();
+    int last = modules.size() - 1;
+    float err;
+    if (head == HEAD_SOFTMAX) {
+        // Cross-entropy loss; gradient straight from the logits
+        err = softmax_ce_grad(grads[last], values[last], label, classes);
+    } else {
+        // Error at the input of the final sigmoid, as in the fixed network
+        last--;
+        makeError(grads[last], values.back(), label, classes);
+        float sum = 0.0f;
+        for (int i = 0; i < classes; ++i) {
+            sum += grads[last][i] * grads[last][i];
+        }
+        err = sqrt(sum);
+    }
+    for (int k = last; k >= 0; --k) {
+        double start = wall_seconds();
+        modules[k]->backward(k > 0 ? values[k - 1] : input, values[k], grads[k], k > 0 ? grads[k - 1] : nullptr);
+        modules[k]->seconds += wall_seconds() - start;
+    }
+    return err;
+}
+
+void Graph::update() {
+    optimizer.step++;
+    for (Module *m : modules) {
+        if (m->weight.n > 0) {
+            optimizer_step(optimizer, m->weight.value, m->weight.grad, m->weight.m, m->weight.v, m->weight.n);
+        }
+        if (m->bias.n > 0) {
+            optimizer_step(optimizer, m->bias.value, m->bias.grad, m->bias.m, m->bias.v, m->bias.n);
+        }
+    }
+}
+
+bool graph_load_config(Graph &graph, const char *path, const InputShape &shape,
+                       const std::vector<std::string> &classes) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Error: cannot open graph config %s\n", path);
+        return false;
+    }
+    std::string text;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        text.append(buf, n);
+    }
+    fclose(file);
+    return graph.build(text, path, shape, classes);
+}
+
+void graph_print(const Graph &graph, FILE *out) {
+    fprintf(out, "Layer graph: %dx%dx%d input, %zu parameters\n", graph.shape.channels, graph.shape.size,
+            graph.shape.size, graph.num_parameters());
+    for (const Module *m : graph.modules) {
+        fprintf(out, "  %-16s -> %dx%dx%d\n", m->describe().c_str(), m->out.c, m->out.h, m->out.w);
+    }
+    fprintf(out, "  %-16s -> %d classes\n", graph.head == HEAD_SOFTMAX ? "softmax" : "(sigmoid head)",
+            graph.num_classes());
+    fprintf(out, "Buffers: %.1f KB activations and gradients, %.1f KB parameters with gradients and optimizer state\n",
+            graph.activation_bytes() / 1024.0, 4 * sizeof(float) * graph.num_parameters() / 1024.0);
+}
+
+void graph_print_times(const Graph &graph, FILE *out) {
+    for (size_t k = 0; k < graph.modules.size(); ++k) {
+        const Module *m = graph.modules[k];
+        fprintf(out, "Total %s Time: %f ms\n", m->describe().c_str(), 1000.0 * m->seconds);
+    }
+}
+
+void graph_learn(Graph &graph, image_data *train_set, unsigned int train_cnt, const TrainOptions &opts,
+                 image_data *eval_set, unsigned int eval_cnt) {
+    int total_epochs = opts.epochs;
+    unsigned int seed = opts.seed;
+    float initial_lr = opts.learning_rate > 0 ? opts.learning_rate : default_learning_rate(graph.optimizer.kind);
+    double time_taken = 0.0;
+
+    DataPipeline pipeline(train_set, graph.shape, opts.pipeline_batch, opts.pipeline_async, seed, opts.augment);
+
+    fprintf(stdout, "Learning with %d epochs and adaptive learning rate (%s, layer graph, %s head, %s, lr %g)\n",
+            total_epochs, CNN_BACKEND_NAME, graph.head == HEAD_SOFTMAX ? "softmax/cross-entropy" : "sigmoid",
+            optimizer_name(graph.optimizer.kind), initial_lr);
+
+    for (int epoch = 1; epoch <= total_epochs; ++epoch) {
+        update_learning_rate(epoch, total_epochs, initial_lr);
+
+        float err = 0.0f;
+        double epoch_start = wall_seconds();
+
+        // Shuffle training indices for randomization; augmentation starts after 10 epochs
+        std::vector<int> indices(train_cnt);
+        for (unsigned int i = 0; i < train_cnt; ++i) indices[i] = i;
+        std::shuffle(indices.begin(), indices.end(), std::default_random_engine(seed + epoch));
+        pipeline.begin_epoch(indices, epoch > 10);
+
+        while (const SampleBatch *batch = pipeline.next()) {
+            for (int s = 0; s < batch->count; ++s) {
+                const PreparedSample &sample = batch->samples[s];
+                double start = wall_seconds();
+                graph.forward(sample.data);
+                err += graph.backward(sample.label);
+                graph.update();
+                time_taken += wall_seconds() - start;
+            }
+        }
+
+        err /= train_cnt;
+        train_seconds += wall_seconds() - epoch_start;
+        train_samples += train_cnt;
+
+        if (epoch % 10 == 0 || epoch == 1 || err < 0.15) {
+            fprintf(stdout, "Epoch %3d/%d - error: %.6f, lr: %.6f, time: %.2lf s\n",
+                    epoch, total_epochs, err, dt, time_taken);
+        }
+        if (err < threshold) {
+            fprintf(stdout, "Training complete, error less than threshold\n\n");
+            break;
+        }
+        if (opts.target_accuracy > 0 && eval_set && eval_cnt > 0) {
+            double accuracy = graph_evaluate(graph, eval_set, eval_cnt);
+            if (accuracy >= opts.target_accuracy) {
+                fprintf(stdout, "Reached %.2lf%% accuracy (target %.2f%%) after %d epochs, %.2lf s of training\n\n",
+                        accuracy, opts.target_accuracy, epoch, train_seconds);
+                break;
+            }
+        }
+
+        apply_epoch_delay();
+        time_taken += epoch_delay_ms / 1000.0;
+    }
+
+    fprintf(stdout, "\n Time - %lf\n", time_taken);
+    fprintf(stdout, "Data pipeline (%s, batch %d): %.3lf s preparing samples, %.3lf s training thread stalled\n",
+            opts.pipeline_async ? "background" : "inline", opts.pipeline_batch,
+            pipeline.prepare_seconds, opts.pipeline_async ? pipeline.stall_seconds : pipeline.prepare_seconds);
+    pipeline.augmenter().report();
+}
+
+unsigned int graph_classify(Graph &graph, const float *input) {
+    graph.forward(input);
+    const float *res = graph.scores();
+    unsigned int max = 0;
+    for (int i = 1; i < graph.num_classes(); ++i) {
+        if (res[max] < res[i]) {
+            max = i;
+        }
+    }
+    return max;
+}
+
+double graph_evaluate(Graph &graph, image_data *set, unsigned int cnt) {
+    unsigned int correct = 0;
+    for (unsigned int i = 0; i < cnt; ++i) {
+        if (graph_classify(graph, set[i].data) == set[i].label) {
+            ++correct;
+        }
+    }
+    return cnt ? 100.0 * correct / cnt : 0.0;
+}
+
+void graph_test(Graph &graph, image_data *test_set, unsigned int test_cnt) {
+    int classes = graph.num_classes();
+    std::vector<int> confusion_matrix(classes * classes, 0);  // [actual][predicted]
+
+    double start = wall_seconds();
+    for (unsigned int i = 0; i < test_cnt; ++i) {
+        confusion_matrix[test_set[i].label * classes + graph_classify(graph, test_set[i].data)]++;
+    }
+    infer_seconds += wall_seconds() - start;
+    infer_samples += test_cnt;
+    print_test_results(graph.class_names, confusion_matrix, test_cnt);
+}
+
+void graph_test_single_image(Graph &graph, const float *input) {
+    unsigned int prediction = graph_classify(graph, input);
+
+    fprintf(stdout, "\n=== Prediction Results ===\n");
+    fprintf(stdout, "Predicted class: %s (label %d)\n", graph.class_names[prediction].c_str(), prediction);
+    fprintf(stdout, "\nConfidence scores:\n");
+    for (int i = 0; i < graph.num_classes(); i++) {
+        fprintf(stdout, "  %s: %.4f\n", graph.class_names[i].c_str(), graph.scores()[i]);
+    }
+    fprintf(stdout, "========================\n\n");
+}
+
+void graph_save(Graph &graph, const char *filename) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open file for writing: %s\n", filename);
+        return;
+    }
+
+    // Header: magic, version, input shape, class names, config text
+    unsigned int version = graph_version, classes = graph.class_names.size(), len;
+    int shape[2] = {graph.shape.size, graph.shape.channels};
+    fwrite(graph_magic, 1, 4, file);
+    fwrite(&version, sizeof(version), 1, file);
+    fwrite(shape, sizeof(int), 2, file);
+    fwrite(&classes, sizeof(classes), 1, file);
+    for (const std::string &name : graph.class_names) {
+        len = name.size();
+        fwrite(&len, sizeof(len), 1, file);
+        fwrite(name.data(), 1, len, file);
+    }
+    len = graph.config.size();
+    fwrite(&len, sizeof(len), 1, file);
+    fwrite(graph.config.data(), 1, len, file);
+
+    for (Module *m : graph.modules) {
+        fwrite(m->weight.value, sizeof(float), m->weight.n, file);
+        fwrite(m->bias.value, sizeof(float), m->bias.n, file);
+    }
+
+    fclose(file);
+    fprintf(stdout, "\nModel saved to %s\n", filename);
+}
+
+// Length-prefixed string of at most `limit` bytes
+static bool read_string(FILE *file, std::string &s, unsigned int limit) {
+    unsigned int len;
+    if (fread(&len, sizeof(len), 1, file) != 1 || len > limit) {
+        return false;
+    }
+    s.resize(len);
+    return len == 0 || fread(&s[0], 1, len, file) == len;
+}
+
+bool graph_load(Graph &graph, const char *filename) {
+    Graph loaded;
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        return false;
+    }
+
+    char magic[4];
+    unsigned int version, classes;
+    int stored[2];
+    bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, graph_magic, 4) == 0 &&
+              fread(&version, sizeof(version), 1, file) == 1 && version == graph_version &&
+              fread(stored, sizeof(int), 2, file) == 2 && InputShape(stored[0], stored[1]).valid() &&
+              fread(&classes, sizeof(classes), 1, file) == 1 && classes >= 2 && classes <= 65536;
+    std::vector<std::string> names(ok ? classes : 0);
+    for (size_t i = 0; ok && i < names.size(); ++i) {
+        ok = read_string(file, names[i], 4096);
+    }
+    std::string config;
+    ok = ok && read_string(file, config, 1 << 20) &&
+         loaded.build(config, filename, InputShape(stored[0], stored[1]), names);
+    for (size_t i = 0; ok && i < loaded.modules.size(); ++i) {
+        Module *m = loaded.modules[i];
+        ok = fread(m->weight.value, sizeof(float), m->weight.n, file) == (size_t)m->weight.n &&
+             fread(m->bias.value, sizeof(float), m->bias.n, file) == (size_t)m->bias.n;
+    }
+
+    fclose(file);
+    if (ok) {
+        loaded.optimizer = graph.optimizer;
+        graph.swap(loaded);
+    }
+    return ok;
+}
@@ -0,0 +1,154 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+// Layer graphs defined at runtime (--graph).
+//
+// A config file lists the stages of a network one per line, from the input
+// to the class scores:
+//   conv <maps> <kernel>   valid kernel x kernel convolution of all input maps
+//   pool <k>               learned k x k subsampling: one k x k weight kernel
+//                          and one bias shared by every map (the fixed
+//                          network's pooling layer)
+//   maxpool <k>            k x k max pooling
+//   fc <units>|classes     fully connected layer
+//   sigmoid, relu          activations
+//   softmax                output head, last line only
+// '#' starts a comment. The last line picks the output head: softmax
+// (cross-entropy on the last layer's outputs) or sigmoid (the error is
+// applied at its input, as in the fixed network). configs/lenet.cfg is the
+// fixed network and trains to the same weights.
+//
+// Activations are planar maps x height x width floats. Every activation,
+// gradient and parameter buffer is allocated once when the graph is built;
+// a training step only runs the modules' kernels.
+
+#include "network.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum ModuleKind {
+    MOD_CONV = 0,
+    MOD_POOL = 1,
+    MOD_MAXPOOL = 2,
+    MOD_FC = 3,
+    MOD_SIGMOID = 4,
+    MOD_RELU = 5
+};
+
+// Shape of an activation: maps x h x w (fully connected: units x 1 x 1)
+struct MapShape {
+    int c, h, w;
+
+    MapShape(int c = 0, int h = 0, int w = 0) : c(c), h(h), w(w) {}
+    int size() const { return c * h * w; }
+};
+
+// A parameter tensor with its gradient and optimizer state, in the graph's
+// parameter buffer
+struct Param {
+    float *value, *grad, *m, *v;
+    int n;
+
+    Param() : value(nullptr), grad(nullptr), m(nullptr), v(nullptr), n(0) {}
+};
+
+// One stage of a graph. Gradients are descent directions like the fixed
+// network's d_* buffers: parameters are updated with param += dt * grad.
+class Module {
+  public:
+    ModuleKind kind;
+    MapShape in, out;
+    Param weight, bias;  // n = 0 for modules without parameters
+    double seconds;      // forward + backward time
+
+    Module(ModuleKind kind, const MapShape &in, const MapShape &out)
+        : kind(kind), in(in), out(out), seconds(0) {}
+    virtual ~Module() {}
+
+    virtual void forward(const float *input, float *output) = 0;
+    // Parameter gradients and, unless d_input is null, the input gradient
+    virtual void backward(const float *input, const float *output, const float *d_output, float *d_input) = 0;
+    // e.g. "conv 6x5x5" or "fc 216->4"
+    virtual std::string describe() const = 0;
+
+  private:
+    Module(const Module &);
+    Module &operator=(const Module &);
+};
+
+class Graph {
+  public:
+    std::string config;  // the config text the graph was built from
+    InputShape shape;
+    OutputHead head;
+    Optimizer optimizer;
+    std::vector<std::string> class_names;
+    std::vector<Module *> modules;
+
+    Graph();
+    ~Graph();
+
+    // Build the modules of `config` for the input shape and classes. Errors
+    // go to stderr with `source` and the line number, and leave the graph
+    // without modules.
+    bool build(const std::string &config, const char *source, const InputShape &shape,
+               const std::vector<std::string> &classes);
+    // Exchange everything, modules and buffers included, with other
+    void swap(Graph &other);
+    // Re-draw all weights and biases from --seed, in the fixed network's order
+    void init_weights(unsigned int seed);
+
+    int num_classes() const { return class_names.size(); }
+    size_t num_parameters() const;
+    size_t activation_bytes() const { return sizeof(float) * activations.size(); }
+
+    // input is shape.pixels() floats, read in place
+    void forward(const float *input);
+    // Class scores of the last forward pass (sigmoid outputs or softmax probabilities)
+    const float *scores() const { return head == HEAD_SOFTMAX ? probs : values.back(); }
+    // Gradients of the last forward pass for `label`; returns the sample's error
+    float backward(unsigned int label);
+    // One optimizer step with the current learning rate dt
+    void update();
+
+  private:
+    void release();
+    bool add_modules(const char *source);
+
+    const float *input;           // of the last forward pass
+    std::vector<float *> values;  // values[k] is the output of module k
+    std::vector<float *> grads;   // grads[k] is the gradient of values[k]
+    float *probs;                 // softmax head output
+    std::vector<float> activations, parameters;
+
+    Graph(const Graph &);
+    Graph &operator=(const Graph &);
+};
+
+// Read a config file and build it; false with a message on stderr
+bool graph_load_config(Graph &graph, const char *path, const InputShape &shape,
+                       const std::vector<std::string> &classes);
+// One line per module with its output shape, then the parameter and buffer sizes
+void graph_print(const Graph &graph, FILE *out);
+// Forward + backward time of each module so far
+void graph_print_times(const Graph &graph, FILE *out);
+
+// learn() for a graph: the same schedule, shuffling and augmentation, one
+// optimizer step (--optimizer) per sample. Checkpoints, validation and
+// streaming are not supported; eval_set is used for --target-accuracy.
+void graph_learn(Graph &graph, image_data *train_set, unsigned int train_cnt, const TrainOptions &opts,
+                 image_data *eval_set = nullptr, unsigned int eval_cnt = 0);
+unsigned int graph_classify(Graph &graph, const float *input);
+double graph_evaluate(Graph &graph, image_data *set, unsigned int cnt);
+void graph_test(Graph &graph, image_data *test_set, unsigned int test_cnt);
+void graph_test_single_image(Graph &graph, const float *input);
+
+// Header (magic, input shape, class names, config text), then the weights
+// and biases of each module. load rebuilds the graph from the stored config
+// and replaces `graph` only if the whole file was read; the optimizer
+// settings are kept.
+void graph_save(Graph &graph, const char *filename);
+bool graph_load(Graph &graph, const char *filename);
+
+#endif // GRAPH_H
@@ -0,0 +1,142 @@
+#include "idx_dataset.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// MSB first, as in mnist.h
+static uint32_t idx_u32(const uint8_t *v) {
+    return ((uint32_t)v[0] << 24) | ((uint32_t)v[1] << 16) | ((uint32_t)v[2] << 8) | v[3];
+}
+
+MappedIdx::MappedIdx() : data(nullptr), base(nullptr), size(0) {
+    dims[0] = dims[1] = dims[2] = 0;
+#ifdef _WIN32
+    file_handle = mapping_handle = nullptr;
+#endif
+}
+
+MappedIdx::~MappedIdx() {
+    close();
+}
+
+void MappedIdx::close() {
+#ifdef _WIN32
+    if (base) UnmapViewOfFile(base);
+    if (mapping_handle) CloseHandle(mapping_handle);
+    if (file_handle) CloseHandle(file_handle);
+    file_handle = mapping_handle = nullptr;
+#else
+    if (base) munmap(base, size);
+#endif
+    base = nullptr;
+    data = nullptr;
+    size = 0;
+}
+
+bool MappedIdx::open(const char *path, int ndims) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    file_handle = file;
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    size = (size_t)file_size.QuadPart;
+    mapping_handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    base = mapping_handle ? MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        size = st.st_size;
+        base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base == MAP_FAILED) {
+            base = nullptr;
+        } else {
+            // Samples are read front to back in big batches
+            madvise(base, size, MADV_WILLNEED);
+        }
+    }
+    ::close(fd);
+#endif
+    if (!base) {
+        fprintf(stderr, "Error: cannot map %s\n", path);
+        close();
+        return false;
+    }
+
+    // Header: magic 0x00000800 | ndims, then one u32 per dimension
+    const uint8_t *bytes = (const uint8_t *)base;
+    size_t header = 4 + 4 * (size_t)ndims;
+    if (size < header || idx_u32(bytes) != (0x800u | (uint32_t)ndims)) {
+        fprintf(stderr, "Error: %s is not an IDX file with %d dimensions\n", path, ndims);
+        close();
+        return false;
+    }
+    size_t elements = 1;
+    for (int d = 0; d < ndims; ++d) {
+        dims[d] = idx_u32(bytes + 4 + 4 * d);
+        elements *= dims[d];
+    }
+    if (size < header + elements) {
+        fprintf(stderr, "Error: %s is truncated\n", path);
+        close();
+        return false;
+    }
+    data = bytes + header;
+    return true;
+}
+
+// <dir>/<split>-<kind>-idx<N>-ubyte, or the <split>-<kind>.idx<N>-ubyte spelling
+static bool open_idx(MappedIdx &idx, const char *dir, const char *split, const char *kind, int ndims) {
+    char path[512], alt_path[512];
+    snprintf(path, sizeof(path), "%s/%s-%s-idx%d-ubyte", dir, split, kind, ndims);
+    snprintf(alt_path, sizeof(alt_path), "%s/%s-%s.idx%d-ubyte", dir, split, kind, ndims);
+    FILE *probe = fopen(path, "rb");
+    if (!probe) {
+        probe = fopen(alt_path, "rb");
+        if (!probe) {
+            fprintf(stderr, "Error: MNIST file %s not found (also tried %s)\n", path, alt_path);
+            return false;
+        }
+        snprintf(path, sizeof(path), "%s", alt_path);
+    }
+    fclose(probe);
+    return idx.open(path, ndims);
+}
+
+bool MnistSet::open(const char *dir, const char *split) {
+    if (!open_idx(images, dir, split, "images", 3) || !open_idx(labels, dir, split, "labels", 1)) {
+        return false;
+    }
+    if (images.dims[1] != 28 || images.dims[2] != 28) {
+        fprintf(stderr, "Error: %s images are %ux%u, expected 28x28\n", split, images.dims[1], images.dims[2]);
+        return false;
+    }
+    if (images.dims[0] != labels.dims[0]) {
+        fprintf(stderr, "Error: %s has %u images but %u labels\n", split, images.dims[0], labels.dims[0]);
+        return false;
+    }
+    for (uint32_t i = 0; i < labels.dims[0]; ++i) {
+        if (labels.data[i] > 9) {
+            fprintf(stderr, "Error: %s label %u is %u, expected 0-9\n", split, i, labels.data[i]);
+            return false;
+        }
+    }
+    view.pixels = images.data;
+    view.labels = labels.data;
+    view.count = images.dims[0];
+    return true;
+}
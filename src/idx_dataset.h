@@ -0,0 +1,49 @@
+#ifndef IDX_DATASET_H
+#define IDX_DATASET_H
+
+// MNIST in IDX format, memory mapped.
+//
+// An IDX file is a big-endian header (magic 0x0000080N for unsigned bytes
+// with N dimensions, then N u32 sizes) followed by the raw bytes. The image
+// and label files are mapped read-only and used in place as 8-bit 28x28
+// images (784 bytes per sample, paged in by the OS) instead of being copied
+// into 6 KB image_data records like mnist.h does.
+
+#include "image_loader.h"
+#include <cstddef>
+#include <cstdint>
+
+// Read-only mapping of one IDX file
+class MappedIdx {
+  public:
+    MappedIdx();
+    ~MappedIdx();
+
+    // Map `path` and check it holds unsigned bytes with `ndims` dimensions
+    bool open(const char *path, int ndims);
+    void close();
+
+    const uint8_t *data;  // first element, after the header
+    uint32_t dims[3];
+
+  private:
+    void *base;
+    size_t size;
+#ifdef _WIN32
+    void *file_handle, *mapping_handle;
+#endif
+
+    MappedIdx(const MappedIdx &);
+    MappedIdx &operator=(const MappedIdx &);
+};
+
+// One MNIST split ("train" or "t10k"): images and labels mapped together
+struct MnistSet {
+    MappedIdx images, labels;
+    ByteImages view;
+
+    // Accepts both train-images-idx3-ubyte and train-images.idx3-ubyte names
+    bool open(const char *dir, const char *split);
+};
+
+#endif // IDX_DATASET_H
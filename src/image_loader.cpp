@@ -0,0 +1,509 @@
+#include "image_loader.h"
+#include "rng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#ifdef CNN_HAVE_LIBJPEG
+#include <setjmp.h>
+#include <jpeglib.h>
+#endif
+
+/* Every allocation stb makes while decoding and resizing comes from the
+   calling thread's decode arena (see DecodeContext below) */
+static void *arena_alloc(size_t size);
+static void *arena_realloc(void *ptr, size_t old_size, size_t new_size);
+
+#define STBI_MALLOC(size) arena_alloc(size)
+#define STBI_REALLOC_SIZED(ptr, old_size, new_size) arena_realloc(ptr, old_size, new_size)
+#define STBI_FREE(ptr) ((void)(ptr))
+#define STBIR_MALLOC(size, user_data) ((void)(user_data), arena_alloc(size))
+#define STBIR_FREE(ptr, user_data) ((void)(ptr), (void)(user_data))
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include "stb_image.h"
+#include "stb_image_resize2.h"
+
+/* Image file extensions the loader accepts */
+static bool is_image_file(const char *filename) {
+    const char *ext = strrchr(filename, '.');
+    if (!ext) return false;
+    return strcmp(ext, ".jpg") == 0 || strcmp(ext, ".jpeg") == 0 ||
+           strcmp(ext, ".png") == 0 || strcmp(ext, ".webp") == 0 ||
+           strcmp(ext, ".JPG") == 0 || strcmp(ext, ".JPEG") == 0 ||
+           strcmp(ext, ".PNG") == 0 || strcmp(ext, ".WEBP") == 0;
+}
+
+/* Paths of the image files in a directory, in directory order */
+int list_image_files(const char *dir_path, std::vector<std::string> &files) {
+    int found = 0;
+    char filepath[512];
+
+#ifdef _WIN32
+    WIN32_FIND_DATAA findData;
+    char searchPath[512];
+    snprintf(searchPath, sizeof(searchPath), "%s\\*.*", dir_path);
+    
+    HANDLE hFind = FindFirstFileA(searchPath, &findData);
+    if (hFind == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Error: Cannot open directory %s\n", dir_path);
+        return 0;
+    }
+    
+    do {
+        if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            continue; // Skip directories
+        }
+        if (is_image_file(findData.cFileName)) {
+            snprintf(filepath, sizeof(filepath), "%s\\%s", dir_path, findData.cFileName);
+            files.push_back(filepath);
+            found++;
+        }
+    } while (FindNextFileA(hFind, &findData));
+    
+    FindClose(hFind);
+#else
+    DIR *dir = opendir(dir_path);
+    if (!dir) {
+        fprintf(stderr, "Error: Cannot open directory %s\n", dir_path);
+        return 0;
+    }
+    
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_type == DT_REG && is_image_file(entry->d_name)) { // Regular file
+            snprintf(filepath, sizeof(filepath), "%s/%s", dir_path, entry->d_name);
+            files.push_back(filepath);
+            found++;
+        }
+    }
+    closedir(dir);
+#endif
+    
+    return found;
+}
+
+#ifdef CNN_HAVE_LIBJPEG
+/* libjpeg reports errors through error_exit, which must not return */
+struct jpeg_error_jump {
+    struct jpeg_error_mgr mgr;
+    jmp_buf jump;
+};
+
+static void jpeg_error_longjmp(j_common_ptr cinfo) {
+    longjmp(((jpeg_error_jump *)cinfo->err)->jump, 1);
+}
+
+static void jpeg_silent(j_common_ptr) {}
+#endif
+
+/* Largest arena kept between images; bigger images overflow to malloc */
+static const size_t decode_arena_max = 32u << 20;
+
+/* Per-thread scratch reused from one image to the next: the encoded file,
+   the full-size decoded image, a libjpeg decompressor and a bump arena
+   for stb's allocations. The arena is reset before every image; requests
+   that do not fit go to malloc and are freed at the reset, after which the
+   arena grows to the last image's total, so a directory of similar images
+   stops allocating after the first few. */
+struct DecodeContext {
+    std::vector<unsigned char> file;
+    std::vector<unsigned char> image;
+
+    unsigned char *arena;
+    size_t arena_size, arena_used, arena_wanted;
+    std::vector<void *> overflow;
+
+#ifdef CNN_HAVE_LIBJPEG
+    struct jpeg_decompress_struct cinfo;
+    jpeg_error_jump err;
+    bool jpeg_ready;
+#endif
+
+    DecodeContext() : arena(NULL), arena_size(0), arena_used(0), arena_wanted(0) {
+#ifdef CNN_HAVE_LIBJPEG
+        jpeg_ready = false;
+#endif
+    }
+
+    ~DecodeContext() {
+        reset();
+        free(arena);
+#ifdef CNN_HAVE_LIBJPEG
+        if (jpeg_ready) {
+            jpeg_destroy_decompress(&cinfo);
+        }
+#endif
+    }
+
+    void reset() {
+        for (size_t i = 0; i < overflow.size(); ++i) {
+            free(overflow[i]);
+        }
+        overflow.clear();
+        if (arena_wanted > arena_size && arena_wanted <= decode_arena_max) {
+            free(arena);
+            arena = (unsigned char *)malloc(arena_wanted);
+            arena_size = arena ? arena_wanted : 0;
+        }
+        arena_used = 0;
+        arena_wanted = 0;
+    }
+};
+
+static thread_local DecodeContext decode_ctx;
+
+static void *arena_alloc(size_t size) {
+    DecodeContext &ctx = decode_ctx;
+    size = (size + 15) & ~(size_t)15;
+    ctx.arena_wanted += size;
+    if (ctx.arena_used + size <= ctx.arena_size) {
+        void *ptr = ctx.arena + ctx.arena_used;
+        ctx.arena_used += size;
+        return ptr;
+    }
+    void *ptr = malloc(size);
+    if (ptr) {
+        ctx.overflow.push_back(ptr);
+    }
+    return ptr;
+}
+
+static void *arena_realloc(void *ptr, size_t old_size, size_t new_size) {
+    DecodeContext &ctx = decode_ctx;
+    size_t old_aligned = (old_size + 15) & ~(size_t)15;
+    size_t new_aligned = (new_size + 15) & ~(size_t)15;
+    // The most recent arena allocation grows in place
+    if (ptr && ptr == ctx.arena + ctx.arena_used - old_aligned &&
+        ctx.arena_used - old_aligned + new_aligned <= ctx.arena_size) {
+        ctx.arena_used += new_aligned - old_aligned;
+        ctx.arena_wanted += new_aligned - old_aligned;
+        return ptr;
+    }
+    void *grown = arena_alloc(new_size);
+    if (ptr && grown) {
+        memcpy(grown, ptr, old_size < new_size ? old_size : new_size);
+    }
+    return grown;
+}
+
+/* Read a whole file into the context's file buffer */
+static bool read_file(DecodeContext &ctx, const char *filepath) {
+    FILE *file = fopen(filepath, "rb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fseek(file, 0, SEEK_END) == 0;
+    long size = ok ? ftell(file) : -1;
+    ok = size > 0 && fseek(file, 0, SEEK_SET) == 0;
+    if (ok) {
+        ctx.file.resize(size);
+        ok = fread(ctx.file.data(), 1, size, file) == (size_t)size;
+    }
+    fclose(file);
+    return ok;
+}
+
+#ifdef CNN_HAVE_LIBJPEG
+/* Decode a JPEG (only the luma channel for grayscale) at the smallest DCT
+   scale (1/8, 1/4, 1/2 or 1/1) that still covers the target size, into
+   ctx.image */
+static bool decode_jpeg_scaled(DecodeContext &ctx, const InputShape &shape, int *width, int *height) {
+    struct jpeg_decompress_struct &cinfo = ctx.cinfo;
+    if (!ctx.jpeg_ready) {
+        cinfo.err = jpeg_std_error(&ctx.err.mgr);
+        ctx.err.mgr.error_exit = jpeg_error_longjmp;
+        ctx.err.mgr.output_message = jpeg_silent; // corrupt files fall back to stb
+        jpeg_create_decompress(&cinfo);
+        ctx.jpeg_ready = true;
+    }
+    if (setjmp(ctx.err.jump)) {
+        jpeg_abort_decompress(&cinfo); // keeps the decompressor reusable
+        return false;
+    }
+
+    jpeg_mem_src(&cinfo, ctx.file.data(), ctx.file.size());
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = shape.channels == 3 ? JCS_RGB : JCS_GRAYSCALE;
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = 8;
+    unsigned int target = shape.size;
+    while (cinfo.scale_denom > 1 && (cinfo.image_width / cinfo.scale_denom < target ||
+                                     cinfo.image_height / cinfo.scale_denom < target)) {
+        cinfo.scale_denom /= 2;
+    }
+    jpeg_start_decompress(&cinfo);
+
+    *width = cinfo.output_width;
+    *height = cinfo.output_height;
+    size_t stride = (size_t)*width * shape.channels;
+    ctx.image.resize(stride * *height);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = ctx.image.data() + cinfo.output_scanline * stride;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    return true;
+}
+#endif
+
+static bool is_jpeg_file(const char *filepath) {
+    const char *ext = strrchr(filepath, '.');
+    if (!ext) return false;
+    return strcmp(ext, ".jpg") == 0 || strcmp(ext, ".jpeg") == 0 ||
+           strcmp(ext, ".JPG") == 0 || strcmp(ext, ".JPEG") == 0;
+}
+
+/* Where the resize writes: planar 8-bit pixels, or normalized floats */
+struct ResizeTarget {
+    int size, channels;
+    unsigned char *pixels;
+    float *data;
+};
+
+/* Resize output rows go straight into the destination, split into planes
+   and normalized when it is float */
+static void write_planar_row(const void *row, int num_pixels, int y, void *context) {
+    const ResizeTarget &target = *(const ResizeTarget *)context;
+    const unsigned char *src = (const unsigned char *)row;
+    size_t plane = (size_t)target.size * target.size;
+    for (int c = 0; c < target.channels; ++c) {
+        size_t first = c * plane + (size_t)y * target.size;
+        if (target.data) {
+            for (int x = 0; x < num_pixels; ++x) {
+                target.data[first + x] = (float)(src[x * target.channels + c] / 255.0);
+            }
+        } else {
+            for (int x = 0; x < num_pixels; ++x) {
+                target.pixels[first + x] = src[x * target.channels + c];
+            }
+        }
+    }
+}
+
+/* Decode to full size in the thread's context, then resize to the shape
+   into pixels, or normalized into data when it is given */
+static int decode_resized(const char *filepath, const InputShape &shape, DecodePath path,
+                          unsigned char *pixels, float *data) {
+    DecodeContext &ctx = decode_ctx;
+    ctx.reset();
+    if (!read_file(ctx, filepath)) {
+        return -1;
+    }
+
+    const unsigned char *img = NULL;
+    int width = 0, height = 0;
+#ifdef CNN_HAVE_LIBJPEG
+    if (path == DECODE_AUTO && is_jpeg_file(filepath) && decode_jpeg_scaled(ctx, shape, &width, &height)) {
+        img = ctx.image.data();
+    }
+#else
+    (void)path;
+    (void)is_jpeg_file;
+#endif
+    if (!img) {
+        int channels;
+        img = stbi_load_from_memory(ctx.file.data(), (int)ctx.file.size(),
+                                    &width, &height, &channels, shape.channels); // grayscale or RGB
+        if (!img) {
+            return -1;
+        }
+    }
+
+    // Resize to size x size; rows are deinterleaved by the callback
+    ResizeTarget target = {shape.size, shape.channels, pixels, data};
+    STBIR_RESIZE resize;
+    stbir_resize_init(&resize, img, width, height, 0,
+                      NULL, shape.size, shape.size, 0,
+                      shape.channels == 3 ? STBIR_RGB : STBIR_1CHANNEL, STBIR_TYPE_UINT8);
+    stbir_set_pixel_callbacks(&resize, NULL, write_planar_row);
+    stbir_set_user_data(&resize, &target);
+    return stbir_resize_extended(&resize) ? 0 : -1;
+}
+
+/* Decode an image file to planar 8-bit pixels */
+int decode_image(const char *filepath, const InputShape &shape, unsigned char *pixels, DecodePath path) {
+    return decode_resized(filepath, shape, path, pixels, NULL);
+}
+
+/* Decode an image file to planar floats normalized to [0, 1] */
+int decode_image(const char *filepath, const InputShape &shape, float *data, DecodePath path) {
+    return decode_resized(filepath, shape, path, NULL, data);
+}
+
+/* Class list from classes.txt or the subdirectories of base_path */
+int discover_classes(const char *base_path, std::vector<std::string> &classes) {
+    classes.clear();
+
+    // Manifest: one class directory per line, blank lines and # comments ignored
+    char manifest_path[512];
+    snprintf(manifest_path, sizeof(manifest_path), "%s/classes.txt", base_path);
+    FILE *manifest = fopen(manifest_path, "r");
+    if (manifest) {
+        char line[512];
+        while (fgets(line, sizeof(line), manifest)) {
+            std::string name(line);
+            name.erase(name.find_last_not_of(" \t\r\n") + 1);
+            name.erase(0, name.find_first_not_of(" \t"));
+            if (!name.empty() && name[0] != '#') {
+                classes.push_back(name);
+            }
+        }
+        fclose(manifest);
+        fprintf(stdout, "Read %d classes from %s\n", (int)classes.size(), manifest_path);
+    } else {
+#ifdef _WIN32
+        WIN32_FIND_DATAA findData;
+        char searchPath[512];
+        snprintf(searchPath, sizeof(searchPath), "%s\\*", base_path);
+        HANDLE hFind = FindFirstFileA(searchPath, &findData);
+        if (hFind != INVALID_HANDLE_VALUE) {
+            do {
+                if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && findData.cFileName[0] != '.') {
+                    classes.push_back(findData.cFileName);
+                }
+            } while (FindNextFileA(hFind, &findData));
+            FindClose(hFind);
+        }
+#else
+        DIR *dir = opendir(base_path);
+        if (dir) {
+            struct dirent *entry;
+            while ((entry = readdir(dir)) != NULL) {
+                if (entry->d_type == DT_DIR && entry->d_name[0] != '.') {
+                    classes.push_back(entry->d_name);
+                }
+            }
+            closedir(dir);
+        }
+#endif
+        // readdir order is arbitrary; sort so labels are stable
+        std::sort(classes.begin(), classes.end());
+    }
+
+    if (classes.size() < 2) {
+        fprintf(stderr, "Error: need at least 2 classes in %s, found %d\n", base_path, (int)classes.size());
+        return -1;
+    }
+    return 0;
+}
+
+/* Load all images of the given classes straight into one array */
+int load_custom_dataset(image_data **data, unsigned int *count,
+                        const std::vector<std::string> &classes,
+                        const InputShape &shape, const char *base_path) {
+    // List every file first so the final array is allocated once
+    std::vector<std::string> files;
+    std::vector<size_t> class_end(classes.size());
+    char dir_path[512];
+    
+    for (size_t label = 0; label < classes.size(); ++label) {
+        snprintf(dir_path, sizeof(dir_path), "%s/%s", base_path, classes[label].c_str());
+        list_image_files(dir_path, files);
+        class_end[label] = files.size();
+    }
+    
+    // Records first, then the pixels of every file back to back
+    size_t slots = files.empty() ? 1 : files.size();
+    size_t bytes = sizeof(image_data) * slots + sizeof(float) * shape.pixels() * slots;
+    *count = 0;
+    *data = (image_data *)malloc(bytes);
+    if (*data == NULL) {
+        fprintf(stderr, "Error: cannot allocate %zu bytes (%.1f MB) for %d images of %dx%dx%d\n", bytes,
+                bytes / 1048576.0, (int)files.size(), shape.size, shape.size, shape.channels);
+        return -1;
+    }
+    float *pixels = (float *)(*data + slots);
+    
+    // Decode each image into its final slot (files that fail to decode are skipped)
+    size_t f = 0;
+    for (size_t label = 0; label < classes.size(); ++label) {
+        unsigned int class_count = 0;
+        for (; f < class_end[label]; ++f) {
+            // Normalized to [0, 1] as the resize writes it
+            image_data &img_data = (*data)[*count];
+            img_data.data = pixels + (size_t)*count * shape.pixels();
+            if (decode_image(files[f].c_str(), shape, img_data.data) != 0) {
+                fprintf(stderr, "Warning: Failed to load %s\n", files[f].c_str());
+                continue;
+            }
+            img_data.label = label;
+            (*count)++;
+            class_count++;
+        }
+        fprintf(stdout, "Loaded %d images from %s (label %d)\n", class_count, classes[label].c_str(), (int)label);
+    }
+    
+    if (*count == 0) {
+        fprintf(stderr, "Error: No images loaded!\n");
+        free(*data);
+        *data = NULL;
+        return -1;
+    }
+    
+    fprintf(stdout, "Total images loaded: %d\n", *count);
+    return 0;
+}
+
+/* Split dataset into train and test sets (80/20 split) */
+void split_dataset(image_data *all_data, unsigned int total_count, unsigned int seed,
+                   image_data **train_set, unsigned int *train_cnt,
+                   image_data **test_set, unsigned int *test_cnt) {
+    // Shuffle an index permutation (same draws as swapping the images)
+    Rng rng(seed, RNG_STREAM_SPLIT);
+    std::vector<unsigned int> perm(total_count);
+    for (unsigned int i = 0; i < total_count; i++) {
+        perm[i] = i;
+    }
+    for (unsigned int i = total_count - 1; i > 0; i--) {
+        unsigned int j = rng.below(i + 1);
+        std::swap(perm[i], perm[j]);
+    }
+    
+    // Apply it in place, cycle by cycle: every image moves once
+    for (unsigned int start = 0; start < total_count; start++) {
+        if (perm[start] == start) {
+            continue;
+        }
+        image_data temp = all_data[start];
+        unsigned int k = start;
+        while (perm[k] != start) {
+            unsigned int from = perm[k];
+            all_data[k] = all_data[from];
+            perm[k] = k;
+            k = from;
+        }
+        all_data[k] = temp;
+        perm[k] = k;
+    }
+    
+    // 80% train, 20% test
+    *train_cnt = (unsigned int)(total_count * 0.8);
+    *test_cnt = total_count - *train_cnt;
+    
+    *train_set = all_data;
+    *test_set = all_data + *train_cnt;
+    
+    fprintf(stdout, "Train set: %d images, Test set: %d images\n", *train_cnt, *test_cnt);
+}
+
+/* Load a single image from file for testing/prediction */
+int load_single_image(const char *filepath, const InputShape &shape, float *data) {
+    // Normalized to [0, 1]
+    if (decode_image(filepath, shape, data) != 0) {
+        fprintf(stderr, "Error: Failed to load image %s\n", filepath);
+        return -1;
+    }
+    
+    return 0;
+}
@@ -0,0 +1,62 @@
+#ifndef __IMAGE_LOADER_H__
+#define __IMAGE_LOADER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "input_shape.h"
+
+typedef struct image_data {
+    float *data;         /* shape.pixels() floats in [0, 1], planar [channel][y][x] */
+    unsigned int label;  /* label: index into the class list */
+} image_data;
+
+/* 8-bit 28x28 images and their labels stored back to back, used in place
+   (e.g. a memory-mapped MNIST IDX file) */
+typedef struct ByteImages {
+    const uint8_t *pixels; /* count * 28 * 28 */
+    const uint8_t *labels; /* count */
+    size_t count;
+} ByteImages;
+
+/* Paths of the image files (jpg, png, webp) in a directory, in directory order */
+int list_image_files(const char *dir_path, std::vector<std::string> &files);
+
+/* How decode_image reads a file:
+   DECODE_AUTO - JPEGs are decoded with libjpeg DCT scaling (1/2, 1/4, 1/8) to
+                 just above the target size when built with libjpeg,
+                 everything else (and any JPEG libjpeg rejects) with stb
+   DECODE_STB  - always stb at full resolution (the original loader) */
+enum DecodePath { DECODE_AUTO, DECODE_STB };
+
+/* Decode an image file to shape.pixels() planar pixels (0-255): grayscale,
+   or the R, G and B planes for 3 channels. Decode and resize buffers are
+   per-thread scratch reused across calls. */
+int decode_image(const char *filepath, const InputShape &shape, unsigned char *pixels,
+                 DecodePath path = DECODE_AUTO);
+/* Same, normalized to [0, 1] as the resize writes each row into data */
+int decode_image(const char *filepath, const InputShape &shape, float *data, DecodePath path = DECODE_AUTO);
+
+/* Class list (label = position): the lines of <base_path>/classes.txt if it
+   exists, otherwise every subdirectory of base_path in alphabetical order */
+int discover_classes(const char *base_path, std::vector<std::string> &classes);
+
+/* Load all images of the given classes from <base_path>/<class name>,
+   decoded at `shape` straight into one malloc'd block: the image_data
+   array followed by the pixels it points to, so one free() releases both */
+int load_custom_dataset(image_data **data, unsigned int *count,
+                        const std::vector<std::string> &classes,
+                        const InputShape &shape, const char *base_path = "data");
+
+/* Split dataset into train and test sets (80/20 split), shuffled reproducibly
+   from seed. all_data is reordered in place and both sets point into it, so
+   only all_data is freed. */
+void split_dataset(image_data *all_data, unsigned int total_count, unsigned int seed,
+                   image_data **train_set, unsigned int *train_cnt,
+                   image_data **test_set, unsigned int *test_cnt);
+
+/* Load a single image from file for testing/prediction, shape.pixels() floats */
+int load_single_image(const char *filepath, const InputShape &shape, float *data);
+
+#endif /* __IMAGE_LOADER_H__ */
@@ -0,0 +1,125 @@
+// cnn_infer: classify images with a trained model (no dataset, no training).
+#include "network.h"
+#include "cnn_helper.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static Network net;
+static InferencePlan plan;
+
+int main(int argc, const char **argv) {
+    const char* model_file = "cnn_model.bin";
+    std::vector<const char *> images;
+    bool quiet = false;
+    int num_threads = 0;
+    int head_override = -1;  // --loss
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) {
+            if (i + 1 < argc) {
+                num_threads = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--model") == 0 || strcmp(argv[i], "-m") == 0) {
+            if (i + 1 < argc) {
+                model_file = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--test-image") == 0 || strcmp(argv[i], "-i") == 0) {
+            if (i + 1 < argc) {
+                images.push_back(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--loss") == 0) {
+            if (i + 1 < argc) {
+                const char *loss = argv[++i];
+                if (strcmp(loss, "softmax") == 0) {
+                    head_override = HEAD_SOFTMAX;
+                } else if (strcmp(loss, "sigmoid") == 0) {
+                    head_override = HEAD_SIGMOID;
+                } else {
+                    fprintf(stderr, "Unknown --loss '%s' (expected sigmoid or softmax)\n", loss);
+                    return 1;
+                }
+            }
+        } else if (strcmp(argv[i], "--quiet") == 0 || strcmp(argv[i], "-q") == 0) {
+            quiet = true;
+        } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [OPTIONS] <image>...\n", argv[0]);
+            printf("Options:\n");
+            printf("  -t, --threads <N>       Set number of OpenMP threads (openmp backend)\n");
+            printf("  --model, -m <file>      Specify model file (default: cnn_model.bin)\n");
+            printf("  --test-image, -i <file> Image to classify (may be repeated)\n");
+            printf("  --loss <sigmoid|softmax> Override the output head stored in the model\n");
+            printf("                          (files without a header default to sigmoid)\n");
+            printf("  --quiet, -q             Only print one line per image\n");
+            printf("  --help, -h              Show this help message\n");
+            printf("\nExample: %s -m cnn_model.bin shoe.jpg watch.png\n", argv[0]);
+            return 0;
+        } else {
+            images.push_back(argv[i]);
+        }
+    }
+
+#ifdef _OPENMP
+    if (num_threads > 0) {
+        omp_set_num_threads(num_threads);
+    }
+#endif
+
+    if (images.empty()) {
+        fprintf(stderr, "No images given (see --help)\n");
+        return 1;
+    }
+
+    if (!load_model(net, model_file)) {
+        fprintf(stderr, "Failed to load model from %s\n", model_file);
+        return 1;
+    }
+    if (head_override >= 0) {
+        net.head = (OutputHead)head_override;
+    }
+    fprintf(stdout, "Model loaded from %s (%s backend, %d classes, %dx%d %s input)\n", model_file, CNN_BACKEND_NAME,
+            net.num_classes(), net.shape.size, net.shape.size, net.shape.channels == 3 ? "RGB" : "grayscale");
+
+    // Only the weights stay; every request runs through two activation buffers
+    plan_inference(net, plan);
+    net.release_training();
+    fprintf(stdout, "Inference plan: %.1f KB per request (forward_pass: %.1f KB), %.1f KB allocated (training layout: %.1f KB)\n",
+            plan.plan_bytes / 1024.0, plan.forward_bytes / 1024.0,
+            (net.allocated_bytes() + sizeof(float) * (plan.ping.size() + plan.pong.size())) / 1024.0,
+            plan.train_bytes / 1024.0);
+
+    // Images are decoded at the model's input shape
+    int failed = 0;
+    double decode_seconds = 0, classify_seconds = 0;
+    std::vector<float> data(net.shape.pixels());
+    for (size_t i = 0; i < images.size(); ++i) {
+        double start = wall_seconds();
+        if (load_single_image(images[i], net.shape, data.data()) != 0) {
+            ++failed;
+            continue;
+        }
+        decode_seconds += wall_seconds() - start;
+
+        start = wall_seconds();
+        unsigned int prediction = classify(net, plan, data.data());
+        classify_seconds += wall_seconds() - start;
+
+        const float *scores = plan.ping.data();
+        if (quiet) {
+            fprintf(stdout, "%s: %s (%.4f)\n", images[i], net.class_names[prediction].c_str(), scores[prediction]);
+        } else {
+            fprintf(stdout, "\nImage: %s", images[i]);
+            print_prediction(net, scores);
+        }
+    }
+
+    unsigned long done = images.size() - failed;
+    fprintf(stdout, "\nThroughput - decode: %.1f images/s, inference: %.1f images/s\n",
+            decode_seconds > 0 ? done / decode_seconds : 0.0,
+            classify_seconds > 0 ? done / classify_seconds : 0.0);
+    return failed ? 1 : 0;
+}
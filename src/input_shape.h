@@ -0,0 +1,31 @@
+#ifndef INPUT_SHAPE_H
+#define INPUT_SHAPE_H
+
+// Input resolution and channel count of a model.
+//
+// Images are square and stored planar, [channel][y][x], normalized to
+// [0, 1]. The layers follow from the size: the 5x5 convolution makes 6 maps
+// of (size - 4)^2 and the 4x4 pooling 6 maps of ((size - 4) / 4)^2, so
+// size - 4 has to be a multiple of 4 (28, 32, 36, ..., 64, ...).
+struct InputShape {
+    int size;      // width = height in pixels
+    int channels;  // 1 (grayscale) or 3 (RGB)
+
+    InputShape(int size = 28, int channels = 1) : size(size), channels(channels) {}
+
+    int pixels() const { return channels * size * size; }  // floats per image
+    int conv_size() const { return size - 4; }
+    int pool_size() const { return (size - 4) / 4; }
+    int features() const { return 6 * pool_size() * pool_size(); }  // fully connected inputs
+
+    bool valid() const {
+        return size >= 8 && size <= max_size && (size - 4) % 4 == 0 && (channels == 1 || channels == 3);
+    }
+    bool operator==(const InputShape &other) const { return size == other.size && channels == other.channels; }
+    bool operator!=(const InputShape &other) const { return !(*this == other); }
+
+    const static int max_size = 512;
+    const static int max_channels = 3;
+};
+
+#endif // INPUT_SHAPE_H
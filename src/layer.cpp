@@ -0,0 +1,713 @@
+#include "layer.h"
+#include <utility>
+#include <vector>
+
+float dt = 5.0E-02f;  // Initial learning rate (will decay over time)
+
+// Function to update learning rate with decay
+void update_learning_rate(int epoch, int total_epochs, float initial_lr) {
+    // Learning rate decay: reduce by factor over time
+    float decay_factor = 0.95f;  // Decay by 5% each epoch
+    dt = initial_lr * pow(decay_factor, epoch);
+
+    // Ensure learning rate doesn't get too small (1e-4 for the default 5e-2)
+    float min_lr = initial_lr * 2.0E-03f;
+    if (dt < min_lr) dt = min_lr;
+}
+
+const char *optimizer_name(OptimizerKind kind) {
+    switch (kind) {
+    case OPT_MOMENTUM: return "momentum";
+    case OPT_NESTEROV: return "nesterov";
+    case OPT_ADAM: return "adam";
+    default: return "sgd";
+    }
+}
+
+float default_learning_rate(OptimizerKind kind) {
+    switch (kind) {
+    case OPT_MOMENTUM:
+    case OPT_NESTEROV:
+        return 5.0E-03f;  // velocity grows to ~grad / (1 - 0.9)
+    case OPT_ADAM:
+        return 1.0E-03f;
+    default:
+        return 5.0E-02f;
+    }
+}
+
+// Constructor
+Layer::Layer(int M, int N, int O) : M(M), N(N), O(O) {
+    allocate();
+}
+
+// Buffers are zero-initialized
+void Layer::allocate() {
+    output = new float[O]();
+    preact = new float[O]();
+    bias = new float[N]();
+    weight = new float[M * N]();
+    d_output = new float[O]();
+    d_preact = new float[O]();
+    d_weight = new float[M * N]();
+    d_bias = new float[N]();
+    m_weight = new float[M * N]();
+    v_weight = new float[M * N]();
+    m_bias = new float[N]();
+    v_bias = new float[N]();
+}
+
+void Layer::release() {
+    delete[] output;
+    delete[] preact;
+    delete[] bias;
+    delete[] weight;
+    delete[] d_output;
+    delete[] d_preact;
+    delete[] d_weight;
+    delete[] d_bias;
+    delete[] m_weight;
+    delete[] v_weight;
+    delete[] m_bias;
+    delete[] v_bias;
+}
+
+void Layer::release_training() {
+    float **buffers[] = {&output, &preact, &d_output, &d_preact, &d_weight, &d_bias,
+                         &m_weight, &v_weight, &m_bias, &v_bias};
+    for (float **b : buffers) {
+        delete[] *b;
+        *b = nullptr;
+    }
+}
+
+size_t Layer::allocated_bytes() const {
+    size_t floats = (size_t)M * N + N;  // weight, bias
+    if (output) {
+        floats += 4 * (size_t)O + 3 * ((size_t)M * N + N);
+    }
+    return sizeof(float) * floats;
+}
+
+void Layer::swap(Layer &other) {
+    std::swap(M, other.M);
+    std::swap(N, other.N);
+    std::swap(O, other.O);
+    float **mine[] = {&output, &preact, &bias, &weight, &d_output, &d_preact, &d_weight, &d_bias,
+                      &m_weight, &v_weight, &m_bias, &v_bias};
+    float **theirs[] = {&other.output, &other.preact, &other.bias, &other.weight, &other.d_output,
+                        &other.d_preact, &other.d_weight, &other.d_bias, &other.m_weight, &other.v_weight,
+                        &other.m_bias, &other.v_bias};
+    for (int i = 0; i < 12; ++i) {
+        std::swap(*mine[i], *theirs[i]);
+    }
+}
+
+void Layer::resize(int M, int N, int O) {
+    release();
+    this->M = M;
+    this->N = N;
+    this->O = O;
+    allocate();
+}
+
+void Layer::init_weights(Rng &rng) {
+    for (int i = 0; i < N; ++i) {
+        bias[i] = 0.5f - rng.uniform();
+
+        for (int j = 0; j < M; ++j) {
+            weight[i * M + j] = 0.5f - rng.uniform();
+        }
+    }
+}
+
+// Destructor
+Layer::~Layer() {
+    release();
+}
+
+const char *layout_name(TensorLayout layout) {
+    switch (layout) {
+    case LAYOUT_NHWC: return "nhwc";
+    case LAYOUT_NCHW8C: return "nchw8c";
+    default: return "nchw";
+    }
+}
+
+bool parse_layout(const char *name, TensorLayout &layout) {
+    if (strcmp(name, "nchw") == 0) {
+        layout = LAYOUT_NCHW;
+    } else if (strcmp(name, "nhwc") == 0) {
+        layout = LAYOUT_NHWC;
+    } else if (strcmp(name, "nchw8c") == 0) {
+        layout = LAYOUT_NCHW8C;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+Tensor::Tensor() : n(0), c(0), h(0), w(0), layout(LAYOUT_NCHW), data(nullptr), capacity(0) {}
+
+Tensor::~Tensor() {
+    delete[] data;
+}
+
+void Tensor::resize(int n, int c, int h, int w, TensorLayout layout) {
+    this->n = n;
+    this->c = c;
+    this->h = h;
+    this->w = w;
+    this->layout = layout;
+    size_t size = (size_t)n * sample_size();
+    if (size > capacity) {
+        delete[] data;
+        data = new float[size];
+        capacity = size;
+    }
+}
+
+int Tensor::blocks() const {
+    switch (layout) {
+    case LAYOUT_NHWC: return 1;
+    case LAYOUT_NCHW8C: return (c + 7) / 8;
+    default: return c;
+    }
+}
+
+int Tensor::lanes() const {
+    switch (layout) {
+    case LAYOUT_NHWC: return c;
+    case LAYOUT_NCHW8C: return 8;
+    default: return 1;
+    }
+}
+
+float step_function(float v) {
+    return 1 / (1 + exp(-v));
+}
+
+void apply_step_function(float *input, float *output, int N) {
+    #pragma omp parallel for simd
+    for (int i = 0; i < N; ++i) {
+        output[i] = step_function(input[i]);
+    }
+}
+
+void makeError(float *err, float *output, unsigned int Y, int N) {
+    for (int i = 0; i < N; ++i) {
+        err[i] = (i == Y) ? 1.0f - output[i] : -output[i];
+    }
+}
+
+void apply_grad(float *output, float *grad, int N) {
+    #pragma omp parallel for simd
+    for (int i = 0; i < N; ++i) {
+        output[i] += dt * grad[i];
+    }
+}
+
+void apply_grad_momentum(float *output, const float *grad, float *velocity, int N, float mu) {
+    #pragma omp parallel for simd
+    for (int i = 0; i < N; ++i) {
+        velocity[i] = mu * velocity[i] + grad[i];
+        output[i] += dt * velocity[i];
+    }
+}
+
+void apply_grad_nesterov(float *output, const float *grad, float *velocity, int N, float mu) {
+    #pragma omp parallel for simd
+    for (int i = 0; i < N; ++i) {
+        float v = mu * velocity[i] + grad[i];
+        velocity[i] = v;
+        // Step along the look-ahead velocity
+        output[i] += dt * (grad[i] + mu * v);
+    }
+}
+
+void apply_grad_adam(float *output, const float *grad, float *m, float *v, int N,
+                     float beta1, float beta2, float eps, unsigned long step) {
+    // Bias correction folded into the step size and epsilon once per call
+    float c1 = 1.0f - pow(beta1, (float)step);
+    float c2 = 1.0f - pow(beta2, (float)step);
+    float lr = dt * sqrt(c2) / c1;
+    float eps_hat = eps * sqrt(c2);
+
+    #pragma omp parallel for simd
+    for (int i = 0; i < N; ++i) {
+        float g = grad[i];
+        float mi = beta1 * m[i] + (1.0f - beta1) * g;
+        float vi = beta2 * v[i] + (1.0f - beta2) * g * g;
+        m[i] = mi;
+        v[i] = vi;
+        output[i] += lr * mi / (sqrtf(vi) + eps_hat);
+    }
+}
+
+void apply_softmax(const float *preact, float *output, int N) {
+    float max = preact[0];
+    for (int i = 1; i < N; ++i) {
+        if (preact[i] > max) max = preact[i];
+    }
+    float sum = 0.0f;
+    for (int i = 0; i < N; ++i) {
+        output[i] = exp(preact[i] - max);
+        sum += output[i];
+    }
+    float inv = 1.0f / sum;
+    for (int i = 0; i < N; ++i) {
+        output[i] *= inv;
+    }
+}
+
+float softmax_ce_grad(float *d_preact, const float *preact, unsigned int Y, int N) {
+    // Max, exp + sum and gradient in one kernel; the exponentials are kept
+    // in d_preact so nothing is recomputed.
+    float max = preact[0];
+    for (int i = 1; i < N; ++i) {
+        if (preact[i] > max) max = preact[i];
+    }
+    float sum = 0.0f;
+    for (int i = 0; i < N; ++i) {
+        d_preact[i] = exp(preact[i] - max);
+        sum += d_preact[i];
+    }
+    float inv = 1.0f / sum;
+    for (int i = 0; i < N; ++i) {
+        d_preact[i] = ((i == Y) ? 1.0f : 0.0f) - d_preact[i] * inv;
+    }
+    // -log(softmax_Y) = log(sum) - (preact_Y - max)
+    return log(sum) - (preact[Y] - max);
+}
+
+
+void fp_c1(const float *input, float *preact, const float *weight, const float *bias, const InputShape &shape) {
+    const int size = shape.size, conv = shape.conv_size(), channels = shape.channels;
+    const int plane = conv * conv;
+
+    // Compute preact values, one input channel at a time
+    #pragma omp parallel for collapse(2)
+    for (int m = 0; m < 6; ++m) {
+        for (int x = 0; x < conv; ++x) {
+            float *out = preact + m * plane + x * conv;
+            for (int c = 0; c < channels; ++c) {
+                const float *in = input + (c * size + x) * size;
+                float w[25];  // in registers for the whole row
+                for (int k = 0; k < 25; ++k) {
+                    w[k] = weight[(m * channels + c) * 25 + k];
+                }
+                conv_channel_row<5>(out, in, w, bias[m], size, conv, 5, c, channels);
+            }
+        }
+    }
+}
+
+
+void fp_s1(const float *input, float *preact, const float *weight, const float *bias, const InputShape &shape) {
+    const int conv = shape.conv_size(), pool = shape.pool_size();
+
+    // Nested loops to simulate the behavior of the CUDA kernel
+    #pragma omp parallel for collapse(2)
+    for (int m = 0; m < 6; ++m) {
+        // for each output feature map
+        for (int x = 0; x < pool; ++x) {
+            // output dimensions are reduced by factor of 4
+            for (int y = 0; y < pool; ++y) {
+                float sum = 0.0f;
+                for (int i = 0; i < 4; ++i) {
+                    // kernel width
+                    for (int j = 0; j < 4; ++j) {
+                        // kernel height
+                        // Applying weights on input and summing up to form the pooled output
+                        sum += weight[i * 4 + j] * input[(m * conv + x * 4 + i) * conv + y * 4 + j];
+                    }
+                }
+                preact[(m * pool + x) * pool + y] = sum + bias[0]; // Pooling operation with weighted sum
+            }
+        }
+    }
+}
+
+
+void fp_preact_f(const float *input, float *preact, const float *weight, int features, int num_outputs) {
+    // Compute the dot product of the input with weights for each output unit.
+    // Each output owns its accumulator, so outputs can run in parallel.
+    #pragma omp parallel for
+    for (int i = 0; i < num_outputs; ++i) { // output dimension
+        const float *w = weight + (size_t)i * features;
+        float sum = 0.0f;
+        #pragma omp simd reduction(+:sum)
+        for (int j = 0; j < features; ++j) { // flattened input
+            sum += w[j] * input[j];
+        }
+        preact[i] = sum;
+    }
+}
+
+
+void fp_bias_f(float *preact, const float *bias, int num_outputs) {
+    // Iterate through each element of the preact array and add the corresponding bias
+    for (int i = 0; i < num_outputs; ++i) {
+        preact[i] += bias[i];
+    }
+}
+
+
+// Batched convolution of C input channels into channels-last blocks of L
+// lanes (NHWC: one block of 6, NCHW8C: one block of 8 with 2 padding
+// maps). Each input pixel is broadcast against the L maps of its block; the
+// accumulators stay in registers. Taps are summed in the same order as
+// fp_c1 for one channel.
+template <int L, int C>
+static void fp_c1_lanes(const float *const *inputs, int size, Tensor &preact, const float *weight, const float *bias) {
+    const int conv = preact.h;
+    const int taps = C * 25;
+    int blocks = preact.blocks();
+    size_t out_stride = preact.sample_size();
+
+    // [block][channel * 25 + tap][lane], zeros for padding maps
+    float packed_weight[2][C * 25][L], packed_bias[2][L];
+    for (int blk = 0; blk < blocks; ++blk) {
+        for (int l = 0; l < L; ++l) {
+            int m = blk * L + l;
+            packed_bias[blk][l] = m < 6 ? bias[m] : 0.0f;
+            for (int k = 0; k < taps; ++k) {
+                packed_weight[blk][k][l] = m < 6 ? weight[m * taps + k] : 0.0f;
+            }
+        }
+    }
+
+    #pragma omp parallel for collapse(2)
+    for (int b = 0; b < preact.n; ++b) {
+        for (int blk = 0; blk < blocks; ++blk) {
+            const float *in = inputs[b];
+            const float (*w)[L] = packed_weight[blk];
+            float *out = preact.data + b * out_stride + (size_t)blk * conv * conv * L;
+            for (int x = 0; x < conv; ++x) {
+                for (int y = 0; y < conv; ++y) {
+                    float acc[L];
+                    for (int l = 0; l < L; ++l) {
+                        acc[l] = 0.0f;
+                    }
+                    for (int c = 0; c < C; ++c) {
+                        const float *plane = in + (size_t)c * size * size;
+                        for (int i = 0; i < 5; ++i) {
+                            for (int j = 0; j < 5; ++j) {
+                                float v = plane[(x + i) * size + y + j];
+                                #pragma omp simd
+                                for (int l = 0; l < L; ++l) {
+                                    acc[l] += v * w[c * 25 + i * 5 + j][l];
+                                }
+                            }
+                        }
+                    }
+                    float *o = out + ((size_t)x * conv + y) * L;
+                    #pragma omp simd
+                    for (int l = 0; l < L; ++l) {
+                        o[l] = acc[l] + packed_bias[blk][l];
+                    }
+                }
+            }
+        }
+    }
+}
+
+// NCHW: the loops of fp_c1, one output plane per (sample, map)
+template <int C>
+static void fp_c1_planes(const float *const *inputs, int size, Tensor &preact, const float *weight, const float *bias) {
+    const int conv = preact.h;
+    size_t out_stride = preact.sample_size();
+    #pragma omp parallel for collapse(2)
+    for (int b = 0; b < preact.n; ++b) {
+        for (int m = 0; m < 6; ++m) {
+            const float *in = inputs[b];
+            float *out = preact.data + b * out_stride + (size_t)m * conv * conv;
+            // The map's taps in locals, so they stay in registers across the row
+            float w[C * 25];
+            for (int k = 0; k < C * 25; ++k) {
+                w[k] = weight[m * C * 25 + k];
+            }
+            for (int x = 0; x < conv; ++x) {
+                // One channel per pass over the row keeps the taps unrolled
+                for (int c = 0; c < C; ++c) {
+                    const float *row = in + ((size_t)c * size + x) * size;
+                    conv_channel_row<5>(out + (size_t)x * conv, row, w + c * 25, bias[m], size, conv, 5, c, C);
+                }
+            }
+        }
+    }
+}
+
+// The channel count is a template argument so the taps fully unroll
+void fp_c1_batch(const float *const *inputs, int channels, int size, Tensor &preact, const float *weight,
+                 const float *bias) {
+    bool rgb = channels == 3;
+    if (preact.layout == LAYOUT_NHWC) {
+        rgb ? fp_c1_lanes<6, 3>(inputs, size, preact, weight, bias)
+            : fp_c1_lanes<6, 1>(inputs, size, preact, weight, bias);
+    } else if (preact.layout == LAYOUT_NCHW8C) {
+        rgb ? fp_c1_lanes<8, 3>(inputs, size, preact, weight, bias)
+            : fp_c1_lanes<8, 1>(inputs, size, preact, weight, bias);
+    } else {
+        rgb ? fp_c1_planes<3>(inputs, size, preact, weight, bias)
+            : fp_c1_planes<1>(inputs, size, preact, weight, bias);
+    }
+}
+
+void fp_c1_batch(const Tensor &input, Tensor &preact, const float *weight, const float *bias) {
+    std::vector<const float *> inputs(input.n);
+    for (int b = 0; b < input.n; ++b) {
+        inputs[b] = input.data + b * input.sample_size();
+    }
+    fp_c1_batch(inputs.data(), input.c, input.h, preact, weight, bias);
+}
+
+
+// Weighted 4x4 pooling of planes of L interleaved channels (NCHW: 6
+// planes of 1, NHWC: 1 plane of 6, NCHW8C: 1 plane of 8)
+template <int L>
+static void fp_s1_lanes(const Tensor &input, Tensor &preact, const float *weight, const float *bias) {
+    const int conv = input.h, pool = preact.h;
+    int blocks = input.blocks();
+    size_t in_stride = input.sample_size(), out_stride = preact.sample_size();
+
+    #pragma omp parallel for collapse(2)
+    for (int b = 0; b < input.n; ++b) {
+        for (int blk = 0; blk < blocks; ++blk) {
+            const float *in = input.data + b * in_stride + (size_t)blk * conv * conv * L;
+            float *out = preact.data + b * out_stride + (size_t)blk * pool * pool * L;
+            for (int x = 0; x < pool; ++x) {
+                for (int y = 0; y < pool; ++y) {
+                    float acc[L];
+                    for (int l = 0; l < L; ++l) {
+                        acc[l] = 0.0f;
+                    }
+                    for (int i = 0; i < 4; ++i) {
+                        for (int j = 0; j < 4; ++j) {
+                            const float *v = in + ((size_t)(x * 4 + i) * conv + y * 4 + j) * L;
+                            #pragma omp simd
+                            for (int l = 0; l < L; ++l) {
+                                acc[l] += weight[i * 4 + j] * v[l];
+                            }
+                        }
+                    }
+                    float *o = out + (x * pool + y) * L;
+                    for (int l = 0; l < L; ++l) {
+                        o[l] = acc[l] + bias[0];
+                    }
+                }
+            }
+        }
+    }
+}
+
+void fp_s1_batch(const Tensor &input, Tensor &preact, const float *weight, const float *bias) {
+    if (input.layout == LAYOUT_NHWC) {
+        fp_s1_lanes<6>(input, preact, weight, bias);
+    } else if (input.layout == LAYOUT_NCHW8C) {
+        fp_s1_lanes<8>(input, preact, weight, bias);
+    } else {
+        fp_s1_lanes<1>(input, preact, weight, bias);
+    }
+}
+
+
+void pack_weight_f(const Tensor &input, const float *weight, float *packed, int num_outputs) {
+    // Row i of the packed matrix is output i's weights in the input's
+    // memory order; padding features get zero weights
+    size_t features = input.sample_size();
+    for (int i = 0; i < num_outputs; ++i) {
+        float *p = packed + i * features;
+        const float *w = weight + (size_t)i * input.c * input.h * input.w;
+        memset(p, 0, sizeof(float) * features);
+        for (int ch = 0; ch < input.c; ++ch) {
+            for (int y = 0; y < input.h; ++y) {
+                for (int x = 0; x < input.w; ++x) {
+                    p[input.offset(0, ch, y, x)] = w[(ch * input.h + y) * input.w + x];
+                }
+            }
+        }
+    }
+}
+
+
+void fp_f_batch(const Tensor &input, float *preact, const float *packed, const float *bias, int num_outputs) {
+    // preact[n][num_outputs] = input[n][features] * packed^T + bias. The
+    // packed weights stay in cache while the batch streams through.
+    size_t features = input.sample_size();
+
+    #pragma omp parallel for
+    for (int b = 0; b < input.n; ++b) {
+        const float *in = input.data + b * features;
+        float *out = preact + (size_t)b * num_outputs;
+        for (int i = 0; i < num_outputs; ++i) {
+            const float *w = packed + i * features;
+            float sum = 0.0f;
+            #pragma omp simd reduction(+:sum)
+            for (size_t j = 0; j < features; ++j) {
+                sum += w[j] * in[j];
+            }
+            out[i] = sum + bias[i];
+        }
+    }
+}
+
+
+void bp_weight_f(float *d_weight, const float *d_preact, const float *p_output, int features, int num_outputs) {
+    // Iterate over all indices for weight updates
+    #pragma omp parallel for
+    for (int i = 0; i < num_outputs; ++i) { // over output dimension
+        float *dw = d_weight + (size_t)i * features;
+        #pragma omp simd
+        for (int j = 0; j < features; ++j) { // flattened input
+            // Calculate the gradient for each weight
+            dw[j] = d_preact[i] * p_output[j];
+        }
+    }
+}
+
+void bp_bias_f(float *d_bias, const float *d_preact, int num_outputs) {
+    // The bias gradient of each output is its d_preact
+    for (int i = 0; i < num_outputs; ++i) {
+        d_bias[i] = d_preact[i];
+    }
+}
+
+
+void bp_output_s1(float *d_output, const float *n_weight, const float *nd_preact, int features, int num_outputs) {
+    // Compute the gradient contribution from each neuron's weight and pre-activation gradient.
+    // Every output element sums over all neurons itself, so elements can run in parallel.
+    #pragma omp parallel for simd
+    for (int j = 0; j < features; ++j) { // flattened output
+        float sum = 0.0f;
+        for (int i1 = 0; i1 < num_outputs; ++i1) { // over each output neuron
+            sum += n_weight[(size_t)i1 * features + j] * nd_preact[i1];
+        }
+        d_output[j] = sum;
+    }
+}
+
+
+void bp_preact_s1(float *d_preact, const float *d_output, const float *preact, int n) {
+    // Iterate through each element to calculate gradient of preactivation
+    #pragma omp parallel for simd
+    for (int k = 0; k < n; ++k) {
+        float o = step_function(preact[k]);
+        d_preact[k] = d_output[k] * o * (1 - o);
+    }
+}
+
+void bp_weight_s1(float *d_weight, const float *d_preact, const float *p_output, const InputShape &shape) {
+    const int conv = shape.conv_size(), pool = shape.pool_size();
+
+    // Compute the gradient for each weight; each weight owns its accumulator
+    #pragma omp parallel for collapse(2)
+    for (int i2 = 0; i2 < 4; ++i2) { // kernel width
+        for (int i3 = 0; i3 < 4; ++i3) { // kernel height
+            float sum = 0.0f;
+            for (int i4 = 0; i4 < 6; ++i4) { // over each output feature map dimension
+                for (int i5 = 0; i5 < pool; ++i5) { // first dimension of output
+                    const float *dp = d_preact + (i4 * pool + i5) * pool;
+                    const float *p = p_output + (i4 * conv + i5 * 4 + i2) * conv + i3;
+                    #pragma omp simd reduction(+:sum)
+                    for (int i6 = 0; i6 < pool; ++i6) { // second dimension of output
+                        // Calculate the corresponding output location and accumulate the gradient
+                        sum += dp[i6] * p[i6 * 4];
+                    }
+                }
+            }
+            d_weight[i2 * 4 + i3] = sum;
+        }
+    }
+}
+
+void bp_bias_s1(float *d_bias, const float *d_preact, int n) {
+    float sum = 0.0f;
+
+    // Sum all gradient contributions
+    #pragma omp simd reduction(+:sum)
+    for (int i = 0; i < n; ++i) {
+        sum += d_preact[i];
+    }
+
+    // Bias gradient is the average of the gradients
+    d_bias[0] = sum / n;
+}
+
+void bp_output_c1(float *d_output, const float *n_weight, const float *nd_preact, const InputShape &shape) {
+    const int conv = shape.conv_size(), pool = shape.pool_size();
+
+    // Calculate the contribution of each neuron's error. The 4x4 pooling
+    // windows do not overlap and cover the whole map (conv is a multiple of
+    // 4), so every element is written exactly once and needs no clearing.
+    #pragma omp parallel for collapse(2)
+    for (int i4 = 0; i4 < 6; ++i4) { // over each output feature map dimension
+        for (int i2 = 0; i2 < 4; ++i2) { // kernel width
+            for (int i3 = 0; i3 < 4; ++i3) { // kernel height
+                for (int i5 = 0; i5 < pool; ++i5) { // reduced dimension due to pooling or stride
+                    for (int i6 = 0; i6 < pool; ++i6) { // reduced dimension due to pooling or stride
+                        // Map the small dimension back to the original large dimension and write the error
+                        int x = i5 * 4 + i2;
+                        int y = i6 * 4 + i3;
+                        d_output[(i4 * conv + x) * conv + y] = n_weight[i2 * 4 + i3] * nd_preact[(i4 * pool + i5) * pool + i6];
+                    }
+                }
+            }
+        }
+    }
+}
+
+void bp_preact_c1(float *d_preact, const float *d_output, const float *preact, int n) {
+    // Compute the gradient of pre-activation for each element (sigmoid derivative)
+    #pragma omp parallel for simd
+    for (int k = 0; k < n; ++k) {
+        float s = 1.0f / (1.0f + exp(-preact[k]));
+        d_preact[k] = d_output[k] * s * (1 - s);
+    }
+}
+
+void bp_weight_c1(float *d_weight, const float *d_preact, const float *p_output, const InputShape &shape) {
+    const int size = shape.size, conv = shape.conv_size(), channels = shape.channels;
+
+    float d = (float)conv * conv;  // Normalization factor
+
+    // Compute the gradient for each weight; each weight owns its accumulator
+    #pragma omp parallel for collapse(4)
+    for (int i1 = 0; i1 < 6; ++i1) {
+        for (int c = 0; c < channels; ++c) {
+            for (int i2 = 0; i2 < 5; ++i2) {
+                for (int i3 = 0; i3 < 5; ++i3) {
+                    float sum = 0.0f;
+                    for (int i4 = 0; i4 < conv; ++i4) {
+                        const float *dp = d_preact + (i1 * conv + i4) * conv;
+                        const float *p = p_output + (c * size + i4 + i2) * size + i3;
+                        #pragma omp simd reduction(+:sum)
+                        for (int i5 = 0; i5 < conv; ++i5) {
+                            sum += dp[i5] * p[i5] / d;
+                        }
+                    }
+                    d_weight[((i1 * channels + c) * 5 + i2) * 5 + i3] = sum;
+                }
+            }
+        }
+    }
+}
+
+
+void bp_bias_c1(float *d_bias, const float *d_preact, const InputShape &shape) {
+    const int plane = shape.conv_size() * shape.conv_size();
+    float d = (float)plane;  // Normalization factor
+
+    // Aggregate gradients for each bias
+    #pragma omp parallel for
+    for (int i = 0; i < 6; ++i) {
+        const float *dp = d_preact + i * plane;
+        float sum = 0.0f;
+        #pragma omp simd reduction(+:sum)
+        for (int j = 0; j < plane; ++j) {
+            sum += dp[j];
+        }
+        // Normalized accumulated gradient of each bias
+        d_bias[i] = sum / d;
+    }
+}
@@ -0,0 +1,226 @@
+#ifndef LAYER_H
+#define LAYER_H
+
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include "rng.h"
+#include "input_shape.h"
+
+// Kernels are written once and built for every backend:
+//   serial  - pragmas ignored
+//   openmp  - #pragma omp parallel for / simd active (-fopenmp)
+//   simd    - only #pragma omp simd active (-fopenmp-simd)
+#ifndef CNN_BACKEND_NAME
+#define CNN_BACKEND_NAME "serial"
+#endif
+
+extern float dt;  // Learning rate (decays over time, see update_learning_rate)
+const static float threshold = 1.0E-02f;
+
+// Function to update learning rate with decay
+void update_learning_rate(int epoch, int total_epochs, float initial_lr = 5.0E-02f);
+
+// Weight/bias update rule applied after every back pass
+enum OptimizerKind {
+    OPT_SGD = 0,       // output += dt * grad
+    OPT_MOMENTUM = 1,  // heavy-ball momentum
+    OPT_NESTEROV = 2,  // Nesterov momentum
+    OPT_ADAM = 3
+};
+
+struct Optimizer {
+    OptimizerKind kind;
+    float momentum;       // momentum / nesterov
+    float beta1, beta2;   // adam moment decay
+    float eps;            // adam
+    unsigned long step;   // updates taken so far (adam bias correction)
+
+    Optimizer() : kind(OPT_SGD), momentum(0.9f), beta1(0.9f), beta2(0.999f), eps(1.0E-08f), step(0) {}
+};
+
+const char *optimizer_name(OptimizerKind kind);
+// Initial learning rate that gives each optimizer a comparable step size
+float default_learning_rate(OptimizerKind kind);
+
+// Memory layout of a batch tensor of n samples with c channels of h x w:
+//   NCHW    - [n][c][h][w], one plane per channel
+//   NHWC    - [n][h][w][c], the channels of a pixel side by side
+//   NCHW8C  - [n][c/8][h][w][8], channels in blocks of 8 (zero padded),
+//             so a block of one pixel fills one 256-bit vector
+enum TensorLayout {
+    LAYOUT_NCHW = 0,
+    LAYOUT_NHWC = 1,
+    LAYOUT_NCHW8C = 2
+};
+
+const char *layout_name(TensorLayout layout);
+// "nchw", "nhwc" or "nchw8c"
+bool parse_layout(const char *name, TensorLayout &layout);
+
+// Batch-major activations. Every layout is addressed as blocks of `lanes`
+// channels: NCHW has c blocks of 1 lane, NHWC 1 block of c lanes and
+// NCHW8C c/8 blocks of 8 lanes.
+struct Tensor {
+    int n, c, h, w;
+    TensorLayout layout;
+    float *data;
+
+    Tensor();
+    ~Tensor();
+
+    // Shape the tensor. The buffer only grows; growing loses the contents,
+    // shrinking keeps them.
+    void resize(int n, int c, int h, int w, TensorLayout layout);
+
+    int blocks() const;
+    int lanes() const;
+    // Floats per sample, padding included
+    size_t sample_size() const { return (size_t)blocks() * h * w * lanes(); }
+    size_t offset(int b, int ch, int y, int x) const {
+        int l = lanes();
+        return (((size_t)b * blocks() + ch / l) * h + y) * w * l + (size_t)x * l + ch % l;
+    }
+
+  private:
+    size_t capacity;
+
+    Tensor(const Tensor &);
+    Tensor &operator=(const Tensor &);
+};
+
+class Layer {
+	public:
+	int M, N, O;
+
+	float *output;
+	float *preact;
+
+	float *bias;
+	float *weight;
+
+	float *d_output;
+	float *d_preact;
+	float *d_weight;
+	float *d_bias;
+
+	// Optimizer state: velocity / first moment and second moment (adam)
+	float *m_weight, *v_weight;
+	float *m_bias, *v_bias;
+
+	Layer(int M, int N, int O);
+
+	~Layer();
+
+	// Uniform weights and biases in [-0.5, 0.5)
+	void init_weights(Rng &rng);
+	// Reallocate all buffers for a new shape (contents are zeroed)
+	void resize(int M, int N, int O);
+	// Free everything but the weights and biases (inference only); resize
+	// brings the buffers back
+	void release_training();
+	// Bytes of the buffers currently allocated
+	size_t allocated_bytes() const;
+	// Exchange sizes and buffers with `other`
+	void swap(Layer &other);
+
+	private:
+	void allocate();
+	void release();
+};
+
+float step_function(float v);
+void apply_step_function(float *input, float *output, int N);  // output may be input
+void makeError(float *err, float *output, unsigned int Y, int N);
+void apply_grad(float *output, float *grad, int N);
+
+// Fused optimizer updates: one pass over parameters, gradient and state,
+// using the current learning rate dt.
+void apply_grad_momentum(float *output, const float *grad, float *velocity, int N, float mu);
+void apply_grad_nesterov(float *output, const float *grad, float *velocity, int N, float mu);
+void apply_grad_adam(float *output, const float *grad, float *m, float *v, int N,
+                     float beta1, float beta2, float eps, unsigned long step);
+
+// Softmax output head: numerically stable softmax (max-subtracted) and the
+// fused softmax + cross-entropy gradient d_preact = onehot(Y) - softmax(preact).
+// softmax_ce_grad returns the cross-entropy loss -log(p_Y). apply_softmax
+// may run in place.
+void apply_softmax(const float *preact, float *output, int N);
+float softmax_ce_grad(float *d_preact, const float *preact, unsigned int Y, int N);
+
+// Kernels overwrite their outputs (write-first), so no buffer has to be
+// cleared between samples.
+
+// Forward pass. Activations are planar: the input has shape.channels planes
+// of shape.size^2, the convolution 6 planes of conv_size^2 and the pooling 6
+// planes of pool_size^2. The convolution weights are [6][channels][5][5],
+// the pooling weights [4][4] and the fully connected ones [outputs][features].
+void fp_c1(const float *input, float *preact, const float *weight, const float *bias, const InputShape &shape);
+void fp_s1(const float *input, float *preact, const float *weight, const float *bias, const InputShape &shape);
+void fp_preact_f(const float *input, float *preact, const float *weight, int features, int num_outputs);
+void fp_bias_f(float *preact, const float *bias, int num_outputs);
+
+// One output row of a valid k x k convolution for one input channel, shared
+// by fp_c1 and the graph's conv module: the taps of each pixel, summed in
+// the same order for every backend. The first channel writes the row and
+// the last one adds the bias, so the output is never cleared. Separate
+// instantiations keep the simd loop free of branches; K > 0 unrolls the
+// taps, K = 0 uses k.
+template <int K, bool First, bool Last>
+inline void conv_row(float *out, const float *in, const float *w, float bias, int width, int out_width, int k) {
+    if (K) k = K;
+    #pragma omp simd
+    for (int y = 0; y < out_width; ++y) {
+        float sum = 0.0f;  // sum needs to be private to each thread
+        for (int i = 0; i < k; ++i) {
+            for (int j = 0; j < k; ++j) {
+                sum += in[i * width + y + j] * w[i * k + j];
+            }
+        }
+        float v = First ? sum : out[y] + sum;
+        out[y] = Last ? v + bias : v;
+    }
+}
+
+// conv_row for channel c of `channels`
+template <int K>
+inline void conv_channel_row(float *out, const float *in, const float *w, float bias, int width, int out_width,
+                             int k, int c, int channels) {
+    if (channels == 1) {
+        conv_row<K, true, true>(out, in, w, bias, width, out_width, k);
+    } else if (c == 0) {
+        conv_row<K, true, false>(out, in, w, bias, width, out_width, k);
+    } else if (c == channels - 1) {
+        conv_row<K, false, true>(out, in, w, bias, width, out_width, k);
+    } else {
+        conv_row<K, false, false>(out, in, w, bias, width, out_width, k);
+    }
+}
+
+// Batched forward pass. Input is n x channels x size x size in NCHW; the
+// outputs take the layout they were resized to and their sizes give the
+// shape. The fully connected layer runs as one (n x features) x
+// (features x N) product against weights packed into the input's feature
+// order.
+void fp_c1_batch(const Tensor &input, Tensor &preact, const float *weight, const float *bias);
+// The same with sample b read in place from inputs[b] (channels x size x size,
+// planar), e.g. straight from the dataset
+void fp_c1_batch(const float *const *inputs, int channels, int size, Tensor &preact, const float *weight,
+                 const float *bias);
+void fp_s1_batch(const Tensor &input, Tensor &preact, const float *weight, const float *bias);
+void pack_weight_f(const Tensor &input, const float *weight, float *packed, int num_outputs);
+void fp_f_batch(const Tensor &input, float *preact, const float *packed, const float *bias, int num_outputs);
+
+// Backward pass, same shapes as the forward pass
+void bp_weight_f(float *d_weight, const float *d_preact, const float *p_output, int features, int num_outputs);
+void bp_bias_f(float *d_bias, const float *d_preact, int num_outputs);
+void bp_output_s1(float *d_output, const float *n_weight, const float *nd_preact, int features, int num_outputs);
+void bp_preact_s1(float *d_preact, const float *d_output, const float *preact, int n);
+void bp_weight_s1(float *d_weight, const float *d_preact, const float *p_output, const InputShape &shape);
+void bp_bias_s1(float *d_bias, const float *d_preact, int n);
+void bp_output_c1(float *d_output, const float *n_weight, const float *nd_preact, const InputShape &shape);
+void bp_preact_c1(float *d_preact, const float *d_output, const float *preact, int n);
+void bp_weight_c1(float *d_weight, const float *d_preact, const float *p_output, const InputShape &shape);
+void bp_bias_c1(float *d_bias, const float *d_preact, const InputShape &shape);
+
+#endif // LAYER_H
@@ -0,0 +1,983 @@
+#include "network.h"
+#include "perf_counters.h"
+#include "cnn_helper.h"
+#include "checkpoint.h"
+#include "data_pipeline.h"
+#include "shard_stream.h"
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <thread>
+
+double total_convolution_time = 0, total_pooling_time = 0, total_fully_connected_time = 0, total_gradient_time = 0;
+
+double train_seconds = 0, infer_seconds = 0;
+unsigned long train_samples = 0, infer_samples = 0;
+
+TensorLayout infer_layout = LAYOUT_NCHW;
+int infer_batch = 64;
+ConvEngine conv_engine = CONV_DIRECT;
+
+// Marks the optimizer state trailer of a model file
+static const char optimizer_tag[4] = {'O', 'P', 'T', '1'};
+
+// Model file header magic; files without it are the original 3-class layout
+static const char model_magic[4] = {'V', 'S', 'C', 'N'};
+static const unsigned int model_version = 2;  // 2 stores the input shape; 1 is 28x28 grayscale
+
+// Classes of the original hardcoded network and headerless model files
+static std::vector<std::string> legacy_classes() {
+    static const char *const names[] = {"Belts", "Shoes", "Watch"};
+    return std::vector<std::string>(names, names + 3);
+}
+
+Network::Network()
+    : input(nullptr),
+      l_c1(5*5, 6, 24*24*6),
+      l_s1(4*4, 1, 6*6*6),
+      l_f(6*6*6, 3, 3),
+      head(HEAD_SIGMOID),
+      class_names(legacy_classes()) {
+    init_weights(0);
+}
+
+Network::Network(const std::vector<std::string> &classes, const InputShape &shape)
+    : input(nullptr),
+      l_c1(5*5*shape.channels, 6, shape.conv_size()*shape.conv_size()*6),
+      l_s1(4*4, 1, shape.features()),
+      l_f(shape.features(), classes.size(), classes.size()),
+      head(HEAD_SIGMOID),
+      class_names(classes),
+      shape(shape) {
+    init_weights(0);
+}
+
+void Network::set_classes(const std::vector<std::string> &classes) {
+    if ((int)classes.size() != l_f.N) {
+        l_f.resize(shape.features(), classes.size(), classes.size());
+    }
+    class_names = classes;
+}
+
+void Network::set_shape(const InputShape &new_shape) {
+    if (new_shape == shape) {
+        return;
+    }
+    shape = new_shape;
+    l_c1.resize(5*5*shape.channels, 6, shape.conv_size()*shape.conv_size()*6);
+    l_s1.resize(4*4, 1, shape.features());
+    l_f.resize(shape.features(), l_f.N, l_f.O);
+}
+
+void Network::init_weights(unsigned int seed) {
+    Rng rng(seed, RNG_STREAM_INIT);
+    l_c1.init_weights(rng);
+    l_s1.init_weights(rng);
+    l_f.init_weights(rng);
+}
+
+void Network::release_training() {
+    l_c1.release_training();
+    l_s1.release_training();
+    l_f.release_training();
+}
+
+void Network::swap(Network &other) {
+    std::swap(input, other.input);
+    l_c1.swap(other.l_c1);
+    l_s1.swap(other.l_s1);
+    l_f.swap(other.l_f);
+    std::swap(head, other.head);
+    std::swap(optimizer, other.optimizer);
+    class_names.swap(other.class_names);
+    std::swap(shape, other.shape);
+}
+
+size_t Network::allocated_bytes() const {
+    return l_c1.allocated_bytes() + l_s1.allocated_bytes() + l_f.allocated_bytes();
+}
+
+static float vectorNorm(float* vec, int n) {
+    float sum = 0.0f;
+    for (int i = 0; i < n; ++i) {
+        sum += vec[i] * vec[i];
+    }
+    return sqrt(sum);
+}
+
+double forward_pass(Network &net, const float *input) {
+    const InputShape &shape = net.shape;
+    double start_1 = wall_seconds();
+    double start;
+
+    net.input = input;
+
+    // forward pass Convolution Layer
+    start = wall_seconds();
+    perf_begin(PK_FP_C1);
+    fp_c1(input, net.l_c1.preact, net.l_c1.weight, net.l_c1.bias, shape);
+    apply_step_function(net.l_c1.preact, net.l_c1.output, net.l_c1.O);
+    perf_end(PK_FP_C1);
+    total_convolution_time += 1000.0 * (wall_seconds() - start);
+
+    // forward pass pooling Layer
+    start = wall_seconds();
+    perf_begin(PK_FP_S1);
+    fp_s1(net.l_c1.output, net.l_s1.preact, net.l_s1.weight, net.l_s1.bias, shape);
+    apply_step_function(net.l_s1.preact, net.l_s1.output, net.l_s1.O);
+    perf_end(PK_FP_S1);
+    total_pooling_time += 1000.0 * (wall_seconds() - start);
+
+    // forward pass Fully Connected Layer
+    start = wall_seconds();
+    perf_begin(PK_FP_F);
+    fp_preact_f(net.l_s1.output, net.l_f.preact, net.l_f.weight, net.l_f.M, net.l_f.N);
+    fp_bias_f(net.l_f.preact, net.l_f.bias, net.l_f.N);
+    if (net.head == HEAD_SOFTMAX) {
+        apply_softmax(net.l_f.preact, net.l_f.output, net.l_f.O);
+    } else {
+        apply_step_function(net.l_f.preact, net.l_f.output, net.l_f.O);
+    }
+    perf_end(PK_FP_F);
+    total_fully_connected_time += 1000.0 * (wall_seconds() - start);
+
+    return wall_seconds() - start_1;
+}
+
+void optimizer_step(const Optimizer &opt, float *param, float *grad, float *m, float *v, int n) {
+    switch (opt.kind) {
+    case OPT_MOMENTUM:
+        apply_grad_momentum(param, grad, m, n, opt.momentum);
+        break;
+    case OPT_NESTEROV:
+        apply_grad_nesterov(param, grad, m, n, opt.momentum);
+        break;
+    case OPT_ADAM:
+        apply_grad_adam(param, grad, m, v, n, opt.beta1, opt.beta2, opt.eps, opt.step);
+        break;
+    default:
+        apply_grad(param, grad, n);
+        break;
+    }
+}
+
+static void optimizer_step(const Optimizer &opt, Layer &l) {
+    optimizer_step(opt, l.weight, l.d_weight, l.m_weight, l.v_weight, l.M * l.N);
+    optimizer_step(opt, l.bias, l.d_bias, l.m_bias, l.v_bias, l.N);
+}
+
+double back_pass(Network &net) {
+    Layer &l_c1 = net.l_c1, &l_s1 = net.l_s1, &l_f = net.l_f;
+    const InputShape &shape = net.shape;
+    double start_1 = wall_seconds();
+    double start;
+
+    start = wall_seconds();
+    perf_begin(PK_BP_F);
+    bp_weight_f(l_f.d_weight, l_f.d_preact, l_s1.output, l_f.M, l_f.N);
+    bp_bias_f(l_f.d_bias, l_f.d_preact, l_f.N);
+    perf_end(PK_BP_F);
+    total_fully_connected_time += 1000.0 * (wall_seconds() - start);
+
+    start = wall_seconds();
+    perf_begin(PK_BP_S1);
+    bp_output_s1(l_s1.d_output, l_f.weight, l_f.d_preact, l_f.M, l_f.N);
+    bp_preact_s1(l_s1.d_preact, l_s1.d_output, l_s1.preact, l_s1.O);
+    bp_weight_s1(l_s1.d_weight, l_s1.d_preact, l_c1.output, shape);
+    bp_bias_s1(l_s1.d_bias, l_s1.d_preact, l_s1.O);
+    perf_end(PK_BP_S1);
+    total_pooling_time += 1000.0 * (wall_seconds() - start);
+
+    start = wall_seconds();
+    perf_begin(PK_BP_OUTPUT_C1);
+    bp_output_c1(l_c1.d_output, l_s1.weight, l_s1.d_preact, shape);
+    perf_end(PK_BP_OUTPUT_C1);
+    perf_begin(PK_BP_PREACT_C1);
+    bp_preact_c1(l_c1.d_preact, l_c1.d_output, l_c1.preact, l_c1.O);
+    perf_end(PK_BP_PREACT_C1);
+    perf_begin(PK_BP_WEIGHT_C1);
+    bp_weight_c1(l_c1.d_weight, l_c1.d_preact, net.input, shape);
+    perf_end(PK_BP_WEIGHT_C1);
+    perf_begin(PK_BP_BIAS_C1);
+    bp_bias_c1(l_c1.d_bias, l_c1.d_preact, shape);
+    perf_end(PK_BP_BIAS_C1);
+    total_convolution_time += 1000.0 * (wall_seconds() - start);
+
+    start = wall_seconds();
+    perf_begin(PK_APPLY_GRAD);
+    net.optimizer.step++;
+    optimizer_step(net.optimizer, l_f);
+    optimizer_step(net.optimizer, l_s1);
+    optimizer_step(net.optimizer, l_c1);
+    perf_end(PK_APPLY_GRAD);
+    total_gradient_time += 1000.0 * (wall_seconds() - start);
+
+    return wall_seconds() - start_1;
+}
+
+// Validation of a snapshot of the network on a second thread, so training
+// continues while the held-out set is classified
+struct Validator {
+    Network net;          // private copy the snapshot is restored into
+    Checkpoint snapshot;  // weights being validated
+    std::thread worker;
+    int epoch;            // epoch the snapshot was taken after
+    double accuracy;
+
+    Checkpoint best;      // best weights validated so far
+    double best_accuracy;
+    int best_epoch;
+    int bad_evals;        // validations in a row without improvement
+
+    explicit Validator(const Network &model)
+        : net(model.class_names, model.shape), epoch(0), accuracy(0), best_accuracy(-1), best_epoch(0), bad_evals(0) {}
+};
+
+static void validation_start(Validator &v, const Network &net, int epoch, image_data *set, unsigned int cnt) {
+    checkpoint_capture(net, v.snapshot);
+    checkpoint_restore(v.net, v.snapshot);
+    v.epoch = epoch;
+    // evaluate runs forward_batch, which touches no timers or perf counters
+    v.worker = std::thread([&v, set, cnt] {
+        v.accuracy = evaluate(v.net, set, cnt);
+    });
+}
+
+// Wait for the running validation, if any, and keep its weights when they are the best so far
+static void validation_finish(Validator &v) {
+    if (!v.worker.joinable()) {
+        return;
+    }
+    v.worker.join();
+
+    if (v.accuracy > v.best_accuracy) {
+        v.best_accuracy = v.accuracy;
+        v.best_epoch = v.epoch;
+        v.bad_evals = 0;
+        std::swap(v.best, v.snapshot);
+    } else {
+        v.bad_evals++;
+    }
+    fprintf(stdout, "Validation after epoch %d: %.2lf%% (best %.2lf%% at epoch %d)\n",
+            v.epoch, v.accuracy, v.best_accuracy, v.best_epoch);
+}
+
+// Finished validations into / out of a checkpoint, so --resume keeps the
+// best weights and the patience counter
+static void validation_save(const Validator &v, Checkpoint &ckpt) {
+    ckpt.best_accuracy = v.best_accuracy;
+    ckpt.best_epoch = v.best_epoch;
+    ckpt.bad_evals = v.bad_evals;
+    ckpt.best_dt = v.best.dt;
+    ckpt.best_step = v.best.optimizer.step;
+    ckpt.best_params = v.best.params;
+}
+
+static void validation_restore(Validator &v, const Checkpoint &ckpt) {
+    v.best_accuracy = ckpt.best_accuracy;
+    v.best_epoch = ckpt.best_epoch;
+    v.bad_evals = ckpt.bad_evals;
+    v.best.head = ckpt.head;
+    v.best.optimizer = ckpt.optimizer;
+    v.best.optimizer.step = ckpt.best_step;
+    v.best.dt = ckpt.best_dt;
+    v.best.params = ckpt.best_params;
+}
+
+void learn(Network &net, image_data *train_set, unsigned int train_cnt, const TrainOptions &opts,
+           image_data *eval_set, unsigned int eval_cnt) {
+    float err;
+	int total_epochs = opts.epochs;  // Total epochs for high accuracy
+	int current_epoch = 0;
+	unsigned int seed = opts.seed;
+	double time_taken = 0.0;
+
+	float initial_lr = opts.learning_rate > 0 ? opts.learning_rate : default_learning_rate(net.optimizer.kind);
+
+	// --resume: the network was restored by the caller; pick up the schedule
+	if (opts.resume_from) {
+		const Checkpoint &ckpt = *opts.resume_from;
+		total_epochs = ckpt.total_epochs;
+		current_epoch = ckpt.epoch;
+		seed = ckpt.seed;
+		initial_lr = ckpt.initial_lr;
+		train_seconds = ckpt.train_seconds;
+		train_samples = ckpt.train_samples;
+	}
+	int iter = total_epochs - current_epoch;
+	if (opts.train_stream) {
+		train_cnt = opts.train_stream->count();
+	} else if (opts.train_bytes) {
+		train_cnt = opts.train_bytes->count;
+	}
+
+	// Shuffled samples are augmented and converted to float ahead of the
+	// training thread; the pipeline owns the augmentation RNG, whose state
+	// is part of every checkpoint
+	DataPipeline pipeline(train_set, net.shape, opts.pipeline_batch, opts.pipeline_async, seed, opts.augment,
+			opts.train_stream, opts.train_bytes);
+	if (opts.resume_from) {
+		if (!checkpoint_restore_rng(*opts.resume_from, pipeline.rng())) {
+			fprintf(stderr, "Warning: checkpoint has no valid RNG state, augmentation restarts from the seed\n");
+		}
+	}
+
+	if (perf_enabled) {
+		perf_set_shape(net.shape, net.num_classes());
+	}
+
+	fprintf(stdout ,"Learning with %d epochs and adaptive learning rate (%s, %s head, %s, lr %g)\n", total_epochs,
+			CNN_BACKEND_NAME, net.head == HEAD_SOFTMAX ? "softmax/cross-entropy" : "sigmoid",
+			optimizer_name(net.optimizer.kind), initial_lr);
+	if (opts.resume_from) {
+		fprintf(stdout, "Resuming after epoch %d of %d\n", current_epoch, total_epochs);
+	}
+
+	CheckpointWriter *writer = nullptr;
+	if (opts.checkpoint_every > 0) {
+		writer = new CheckpointWriter(opts.checkpoint_path);
+	}
+
+	Validator *validator = nullptr;
+	if (opts.val_every > 0 && eval_set && eval_cnt > 0) {
+		validator = new Validator(net);
+	}
+	// --resume: take over the finished validations. The checkpoint was
+	// captured before its own epoch's validation started, so start that now
+	if (validator && opts.resume_from) {
+		validation_restore(*validator, *opts.resume_from);
+		if (current_epoch % opts.val_every == 0) {
+			if (opts.patience > 0 && validator->bad_evals >= opts.patience) {
+				fprintf(stdout, "Early stopping: no improvement in %d validations\n\n", opts.patience);
+				iter = 0;
+			} else {
+				validation_start(*validator, net, current_epoch, eval_set, eval_cnt);
+			}
+		}
+	}
+
+	while (iter < 0 || iter-- > 0) {
+		current_epoch++;
+
+		// Update learning rate with decay
+		update_learning_rate(current_epoch, total_epochs, initial_lr);
+
+		err = 0.0f;
+		perf_epoch_begin();
+		double epoch_start = wall_seconds();
+
+		// Random augmentation, starting after 10 epochs
+		if (opts.train_stream) {
+			// Shard order and shuffle window from the seed
+			pipeline.begin_stream_epoch(seed + current_epoch, current_epoch > 10);
+		} else {
+			// Shuffle training indices for randomization
+			std::vector<int> indices(train_cnt);
+			for(int i = 0; i < train_cnt; ++i) indices[i] = i;
+			std::shuffle(indices.begin(), indices.end(), std::default_random_engine(seed + current_epoch));
+			pipeline.begin_epoch(indices, current_epoch > 10);
+		}
+
+		while (const SampleBatch *batch = pipeline.next()) {
+			for (int s = 0; s < batch->count; ++s) {
+				const PreparedSample &sample = batch->samples[s];
+				float tmp_err;
+
+				time_taken += forward_pass(net, sample.data);
+
+				if (net.head == HEAD_SOFTMAX) {
+					// Cross-entropy loss; gradient straight from the logits
+					tmp_err = softmax_ce_grad(net.l_f.d_preact, net.l_f.preact, sample.label, net.num_classes());
+				} else {
+					// Euclid distance of the sample
+					makeError(net.l_f.d_preact, net.l_f.output, sample.label, net.num_classes());
+					tmp_err = vectorNorm(net.l_f.d_preact, net.num_classes());
+				}
+				err += tmp_err;
+				time_taken += back_pass(net);
+			}
+		}
+
+        err /= train_cnt;
+		train_seconds += wall_seconds() - epoch_start;
+		train_samples += train_cnt;
+		perf_epoch_end(current_epoch);
+
+		// Snapshot now, write in the background
+		if (writer && current_epoch % opts.checkpoint_every == 0) {
+			Checkpoint ckpt;
+			ckpt.epoch = current_epoch;
+			ckpt.total_epochs = total_epochs;
+			ckpt.seed = seed;
+			ckpt.initial_lr = initial_lr;
+			ckpt.train_seconds = train_seconds;
+			ckpt.train_samples = train_samples;
+			checkpoint_capture(net, ckpt);
+			checkpoint_capture_rng(pipeline.rng(), ckpt);
+			// A checkpoint holds only finished validations; the running one
+			// usually ended alongside this epoch
+			if (validator) {
+				validation_finish(*validator);
+				validation_save(*validator, ckpt);
+			}
+			writer->submit(ckpt);
+		}
+
+		// Print progress every 10 epochs or if error is very low
+		if (current_epoch % 10 == 0 || current_epoch == 1 || err < 0.15) {
+			fprintf(stdout, "Epoch %3d/%d - error: %.6f, lr: %.6f, time: %.2lf s\n",
+					current_epoch, total_epochs, err, dt, time_taken);
+		}
+
+		if (err < threshold) {
+			fprintf(stdout, "Training complete, error less than threshold\n\n");
+			break;
+		}
+
+		// Time-to-target-accuracy: evaluation time is not counted as training time
+		if (opts.target_accuracy > 0 && ((eval_set && eval_cnt > 0) || opts.eval_stream || opts.eval_bytes)) {
+			double accuracy = opts.eval_stream ? evaluate(net, *opts.eval_stream)
+					: opts.eval_bytes ? evaluate(net, *opts.eval_bytes) : evaluate(net, eval_set, eval_cnt);
+			if (accuracy >= opts.target_accuracy) {
+				fprintf(stdout, "Reached %.2lf%% accuracy (target %.2f%%) after %d epochs, %.2lf s of training\n\n",
+						accuracy, opts.target_accuracy, current_epoch, train_seconds);
+				break;
+			}
+		}
+
+		// Collect the previous validation (it ran alongside this epoch), then start one on this epoch's weights
+		if (validator && current_epoch % opts.val_every == 0) {
+			validation_finish(*validator);
+			if (opts.patience > 0 && validator->bad_evals >= opts.patience) {
+				fprintf(stdout, "Early stopping: no improvement in %d validations\n\n", opts.patience);
+				break;
+			}
+			validation_start(*validator, net, current_epoch, eval_set, eval_cnt);
+		}
+
+        apply_epoch_delay();
+        time_taken += epoch_delay_ms / 1000.0;
+	}
+
+	// Keep the best validated weights rather than the last ones
+	if (validator) {
+		validation_finish(*validator);
+		if (validator->best_epoch > 0 && validator->best_epoch != current_epoch) {
+			checkpoint_restore(net, validator->best);
+			fprintf(stdout, "Restored best weights from epoch %d (validation accuracy %.2lf%%)\n",
+					validator->best_epoch, validator->best_accuracy);
+		}
+		delete validator;
+	}
+
+	// Waits for the last checkpoint to reach the disk
+	delete writer;
+
+	fprintf(stdout, "\n Time - %lf\n", time_taken);
+	fprintf(stdout, "Data pipeline (%s, batch %d): %.3lf s preparing samples, %.3lf s training thread stalled\n",
+			opts.pipeline_async ? "background" : "inline", opts.pipeline_batch,
+			pipeline.prepare_seconds, opts.pipeline_async ? pipeline.stall_seconds : pipeline.prepare_seconds);
+	if (opts.train_stream) {
+		fprintf(stdout, "Shard stream: %.3lf s reading shards (readahead), %.3lf s waiting for them\n",
+				opts.train_stream->read_seconds, opts.train_stream->wait_seconds);
+	}
+	pipeline.augmenter().report();
+}
+
+// Class with the highest output after a forward pass
+static unsigned int predicted_class(const Network &net) {
+    const float *res = net.l_f.output;
+    unsigned int max = 0;
+    for (int i = 1; i < net.num_classes(); ++i) {
+        if (res[max] < res[i]) {
+            max = i;
+        }
+    }
+
+    return max;
+}
+
+unsigned int classify(Network &net, const float *input) {
+    forward_pass(net, input);
+    return predicted_class(net);
+}
+
+void plan_inference(const Network &net, InferencePlan &plan) {
+    const InputShape &shape = net.shape;
+    int conv = shape.conv_size(), classes = net.num_classes();
+    size_t c1 = 6 * (size_t)conv * conv, s1 = shape.features();
+    size_t weights = (size_t)net.l_c1.M * net.l_c1.N + net.l_c1.N + net.l_s1.M * net.l_s1.N + net.l_s1.N +
+                     (size_t)net.l_f.M * net.l_f.N + net.l_f.N;
+    plan.ping.resize(std::max(c1, (size_t)classes));
+    plan.pong.resize(s1);
+
+    plan.train_bytes = net.allocated_bytes();
+    // forward_pass: the input, preact and output of every layer
+    plan.forward_bytes = sizeof(float) * (weights + shape.pixels() + 2 * (c1 + s1 + classes));
+    plan.plan_bytes = sizeof(float) * (weights + plan.ping.size() + plan.pong.size());
+}
+
+const float *infer(const Network &net, InferencePlan &plan, const float *input) {
+    const InputShape &shape = net.shape;
+    int classes = net.num_classes();
+    float *ping = plan.ping.data(), *pong = plan.pong.data();
+
+    // Convolution into ping, pooling into pong, scores into ping; each
+    // activation overwrites its preact
+    fp_c1(input, ping, net.l_c1.weight, net.l_c1.bias, shape);
+    apply_step_function(ping, ping, 6 * shape.conv_size() * shape.conv_size());
+    fp_s1(ping, pong, net.l_s1.weight, net.l_s1.bias, shape);
+    apply_step_function(pong, pong, shape.features());
+    fp_preact_f(pong, ping, net.l_f.weight, shape.features(), classes);
+    fp_bias_f(ping, net.l_f.bias, classes);
+    if (net.head == HEAD_SOFTMAX) {
+        apply_softmax(ping, ping, classes);
+    } else {
+        apply_step_function(ping, ping, classes);
+    }
+    return ping;
+}
+
+unsigned int classify(const Network &net, InferencePlan &plan, const float *input) {
+    const float *res = infer(net, plan, input);
+    unsigned int max = 0;
+    for (int i = 1; i < net.num_classes(); ++i) {
+        if (res[max] < res[i]) {
+            max = i;
+        }
+    }
+    return max;
+}
+
+void forward_batch(Network &net, BatchWorkspace &ws) {
+    int n = ws.samples.size(), classes = net.num_classes();
+    int size = net.shape.size, conv = net.shape.conv_size(), pool = net.shape.pool_size();
+    ws.ping.resize(n, 6, conv, conv, infer_layout);
+    ws.pong.resize(n, 6, pool, pool, infer_layout);
+
+    // The engines convolve one plane; RGB inputs use the direct loops
+    if (conv_engine != CONV_DIRECT && infer_layout == LAYOUT_NCHW && net.shape.channels == 1) {
+        for (int b = 0; b < n; ++b) {
+            conv5x5(conv_engine, ws.samples[b], size, size,
+                    ws.ping.data + b * ws.ping.sample_size(), net.l_c1.weight, net.l_c1.bias, 6);
+        }
+    } else {
+        fp_c1_batch(ws.samples.data(), net.shape.channels, size, ws.ping, net.l_c1.weight, net.l_c1.bias);
+    }
+    apply_step_function(ws.ping.data, ws.ping.data, n * (int)ws.ping.sample_size());
+
+    fp_s1_batch(ws.ping, ws.pong, net.l_s1.weight, net.l_s1.bias);
+    apply_step_function(ws.pong.data, ws.pong.data, n * (int)ws.pong.sample_size());
+
+    ws.f_weight.resize(classes * ws.pong.sample_size());
+    ws.scores.resize(n * classes);
+    pack_weight_f(ws.pong, net.l_f.weight, ws.f_weight.data(), classes);
+    fp_f_batch(ws.pong, ws.scores.data(), ws.f_weight.data(), net.l_f.bias, classes);
+    if (net.head == HEAD_SOFTMAX) {
+        for (int b = 0; b < n; ++b) {
+            apply_softmax(&ws.scores[b * classes], &ws.scores[b * classes], classes);
+        }
+    } else {
+        apply_step_function(ws.scores.data(), ws.scores.data(), n * classes);
+    }
+}
+
+void classify_batch(Network &net, BatchWorkspace &ws, unsigned int *predictions) {
+    forward_batch(net, ws);
+    int classes = net.num_classes();
+    for (size_t b = 0; b < ws.samples.size(); ++b) {
+        const float *res = &ws.scores[b * classes];
+        unsigned int max = 0;
+        for (int i = 1; i < classes; ++i) {
+            if (res[max] < res[i]) {
+                max = i;
+            }
+        }
+        predictions[b] = max;
+    }
+}
+
+// Point the workspace's samples at the first n images of ws.input
+static void use_converted_input(BatchWorkspace &ws, int n) {
+    ws.samples.resize(n);
+    for (int b = 0; b < n; ++b) {
+        ws.samples[b] = ws.input.data + b * ws.input.sample_size();
+    }
+}
+
+// Predictions for a whole set, infer_batch samples per forward pass; the
+// images are read in place
+static void classify_all(Network &net, image_data *set, unsigned int cnt, std::vector<unsigned int> &predictions) {
+    BatchWorkspace ws;
+    predictions.resize(cnt);
+    for (unsigned int first = 0; first < cnt; first += infer_batch) {
+        unsigned int n = std::min(cnt - first, (unsigned int)infer_batch);
+        ws.samples.resize(n);
+        for (unsigned int b = 0; b < n; ++b) {
+            ws.samples[b] = set[first + b].data;
+        }
+        classify_batch(net, ws, &predictions[first]);
+    }
+}
+
+// 8-bit 28x28 grayscale images (MNIST)
+static void classify_all(Network &net, const ByteImages &set, std::vector<unsigned int> &predictions) {
+    BatchWorkspace ws;
+    predictions.resize(set.count);
+    for (size_t first = 0; first < set.count; first += infer_batch) {
+        size_t n = std::min(set.count - first, (size_t)infer_batch);
+        ws.input.resize((int)n, 1, 28, 28, LAYOUT_NCHW);
+        const uint8_t *pixels = set.pixels + first * 28 * 28;
+        for (size_t i = 0; i < n * 28 * 28; ++i) {
+            ws.input.data[i] = pixels[i] / 255.0f;
+        }
+        use_converted_input(ws, (int)n);
+        classify_batch(net, ws, &predictions[first]);
+    }
+}
+
+// Shard records (28x28 grayscale) in file order, with their labels
+static void classify_all(Network &net, ShardStream &stream, std::vector<unsigned int> &predictions,
+                         std::vector<unsigned int> &labels) {
+    BatchWorkspace ws;
+    ShardRecord record;
+    predictions.clear();
+    labels.clear();
+    stream.begin_epoch(0);
+    bool more = true;
+    while (more) {
+        // Room for a full batch; the records of a short last batch fill its front
+        ws.input.resize(infer_batch, 1, 28, 28, LAYOUT_NCHW);
+        int n = 0;
+        while (n < infer_batch && (more = stream.next(record))) {
+            float *input = ws.input.data + n * 28 * 28;
+            for (int i = 0; i < 28 * 28; ++i) {
+                input[i] = record.pixels[i] / 255.0f;
+            }
+            labels.push_back(record.label);
+            ++n;
+        }
+        if (n == 0) {
+            break;
+        }
+        use_converted_input(ws, n);
+        predictions.resize(predictions.size() + n);
+        classify_batch(net, ws, &predictions[predictions.size() - n]);
+    }
+}
+
+double evaluate(Network &net, image_data *set, unsigned int cnt) {
+    std::vector<unsigned int> predictions;
+    classify_all(net, set, cnt, predictions);
+    unsigned int correct = 0;
+    for (unsigned int i = 0; i < cnt; ++i) {
+        if (predictions[i] == set[i].label) {
+            ++correct;
+        }
+    }
+    return cnt ? 100.0 * correct / cnt : 0.0;
+}
+
+double evaluate(Network &net, ShardStream &stream) {
+    std::vector<unsigned int> predictions, labels;
+    classify_all(net, stream, predictions, labels);
+    unsigned int correct = 0, cnt = predictions.size();
+    for (unsigned int i = 0; i < cnt; ++i) {
+        if (predictions[i] == labels[i]) {
+            ++correct;
+        }
+    }
+    return cnt ? 100.0 * correct / cnt : 0.0;
+}
+
+double evaluate(Network &net, const ByteImages &set) {
+    std::vector<unsigned int> predictions;
+    classify_all(net, set, predictions);
+    unsigned int correct = 0;
+    for (size_t i = 0; i < set.count; ++i) {
+        if (predictions[i] == set.labels[i]) {
+            ++correct;
+        }
+    }
+    return set.count ? 100.0 * correct / set.count : 0.0;
+}
+
+void print_test_results(const std::vector<std::string> &class_names, const std::vector<int> &confusion_matrix,
+                        unsigned int test_cnt)
+{
+	int classes = class_names.size();
+	int error = test_cnt;
+	for (int i = 0; i < classes; i++) {
+		error -= confusion_matrix[i * classes + i];
+	}
+
+	fprintf(stdout, "\n=== Test Results ===\n");
+	fprintf(stdout, "Total Test Samples: %d\n", test_cnt);
+	fprintf(stdout, "Correct: %d\n", test_cnt - error);
+	fprintf(stdout, "Incorrect: %d\n", error);
+	fprintf(stdout, "Accuracy: %.2lf%%\n",
+		(1.0 - double(error) / double(test_cnt)) * 100.0);
+	fprintf(stdout, "Error Rate: %.2lf%%\n\n",
+		double(error) / double(test_cnt) * 100.0);
+
+	// Column headers are truncated to the column width
+	fprintf(stdout, "Confusion Matrix:\n");
+	fprintf(stdout, "%-17s", "Actual\\Predicted");
+	for (int j = 0; j < classes; j++) {
+		fprintf(stdout, " %6.6s", class_names[j].c_str());
+	}
+	fprintf(stdout, "\n%s\n", std::string(17 + 7 * classes, '-').c_str());
+	for (int i = 0; i < classes; i++) {
+		fprintf(stdout, "%-17.17s", class_names[i].c_str());
+		for (int j = 0; j < classes; j++) {
+			fprintf(stdout, "%7d", confusion_matrix[i * classes + j]);
+		}
+		fprintf(stdout, "\n");
+	}
+	fprintf(stdout, "===================\n");
+}
+
+void test(Network &net, image_data *test_set, unsigned int test_cnt)
+{
+	int classes = net.num_classes();
+	std::vector<int> confusion_matrix(classes * classes, 0); // [actual][predicted]
+	std::vector<unsigned int> predictions;
+
+	double start = wall_seconds();
+	classify_all(net, test_set, test_cnt, predictions);
+	infer_seconds += wall_seconds() - start;
+	infer_samples += test_cnt;
+
+	for (unsigned int i = 0; i < test_cnt; ++i) {
+		confusion_matrix[test_set[i].label * classes + predictions[i]]++;
+	}
+	print_test_results(net.class_names, confusion_matrix, test_cnt);
+}
+
+void test(Network &net, ShardStream &stream)
+{
+	int classes = net.num_classes();
+	std::vector<int> confusion_matrix(classes * classes, 0); // [actual][predicted]
+	std::vector<unsigned int> predictions, labels;
+
+	double start = wall_seconds();
+	classify_all(net, stream, predictions, labels);
+	infer_seconds += wall_seconds() - start;
+	infer_samples += predictions.size();
+
+	for (size_t i = 0; i < predictions.size(); ++i) {
+		confusion_matrix[labels[i] * classes + predictions[i]]++;
+	}
+	print_test_results(net.class_names, confusion_matrix, predictions.size());
+}
+
+void test(Network &net, const ByteImages &set)
+{
+	int classes = net.num_classes();
+	std::vector<int> confusion_matrix(classes * classes, 0); // [actual][predicted]
+	std::vector<unsigned int> predictions;
+
+	double start = wall_seconds();
+	classify_all(net, set, predictions);
+	infer_seconds += wall_seconds() - start;
+	infer_samples += set.count;
+
+	for (size_t i = 0; i < set.count; ++i) {
+		confusion_matrix[set.labels[i] * classes + predictions[i]]++;
+	}
+	print_test_results(net.class_names, confusion_matrix, set.count);
+}
+
+// Save model weights to file
+void save_model(Network &net, const char* filename) {
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open file for writing: %s\n", filename);
+        return;
+    }
+
+    // Header: magic, version, input shape, output head, class names
+    unsigned int version = model_version, classes = net.class_names.size();
+    int head = net.head;
+    int shape[2] = {net.shape.size, net.shape.channels};
+    fwrite(model_magic, 1, 4, file);
+    fwrite(&version, sizeof(version), 1, file);
+    fwrite(shape, sizeof(int), 2, file);
+    fwrite(&head, sizeof(head), 1, file);
+    fwrite(&classes, sizeof(classes), 1, file);
+    for (const std::string &name : net.class_names) {
+        unsigned int len = name.size();
+        fwrite(&len, sizeof(len), 1, file);
+        fwrite(name.data(), 1, len, file);
+    }
+
+    // Save convolution layer weights and biases
+    fwrite(net.l_c1.weight, sizeof(float), net.l_c1.M * net.l_c1.N, file);
+    fwrite(net.l_c1.bias, sizeof(float), net.l_c1.N, file);
+
+    // Save pooling layer weights and biases
+    fwrite(net.l_s1.weight, sizeof(float), net.l_s1.M * net.l_s1.N, file);
+    fwrite(net.l_s1.bias, sizeof(float), net.l_s1.N, file);
+
+    // Save fully connected layer weights and biases
+    fwrite(net.l_f.weight, sizeof(float), net.l_f.M * net.l_f.N, file);
+    fwrite(net.l_f.bias, sizeof(float), net.l_f.N, file);
+
+    // Optimizer state trailer; SGD has no state
+    const Optimizer &opt = net.optimizer;
+    if (opt.kind != OPT_SGD) {
+        int kind = opt.kind;
+        unsigned long long step = opt.step;
+        fwrite(optimizer_tag, 1, 4, file);
+        fwrite(&kind, sizeof(kind), 1, file);
+        fwrite(&step, sizeof(step), 1, file);
+        Layer *layers[] = {&net.l_c1, &net.l_s1, &net.l_f};
+        for (Layer *l : layers) {
+            fwrite(l->m_weight, sizeof(float), l->M * l->N, file);
+            fwrite(l->v_weight, sizeof(float), l->M * l->N, file);
+            fwrite(l->m_bias, sizeof(float), l->N, file);
+            fwrite(l->v_bias, sizeof(float), l->N, file);
+        }
+    }
+
+    fclose(file);
+    fprintf(stdout, "\nModel saved to %s\n", filename);
+}
+
+// Read `count` floats into dst; false on short read
+static bool read_floats(FILE *file, float *dst, size_t count) {
+    return fread(dst, sizeof(float), count, file) == count;
+}
+
+// Optional optimizer state after the weights; false if it is truncated
+static bool read_optimizer_state(FILE *file, Network &net) {
+    char tag[4];
+    if (fread(tag, 1, 4, file) != 4) {
+        return true;  // weights only (SGD or a file without optimizer state)
+    }
+    int kind;
+    unsigned long long step;
+    if (memcmp(tag, optimizer_tag, 4) != 0 ||
+        fread(&kind, sizeof(kind), 1, file) != 1 ||
+        fread(&step, sizeof(step), 1, file) != 1 ||
+        kind < OPT_SGD || kind > OPT_ADAM) {
+        return false;
+    }
+    Layer *layers[] = {&net.l_c1, &net.l_s1, &net.l_f};
+    for (Layer *l : layers) {
+        if (!read_floats(file, l->m_weight, l->M * l->N) ||
+            !read_floats(file, l->v_weight, l->M * l->N) ||
+            !read_floats(file, l->m_bias, l->N) ||
+            !read_floats(file, l->v_bias, l->N)) {
+            return false;
+        }
+    }
+    net.optimizer.kind = (OptimizerKind)kind;
+    net.optimizer.step = step;
+    return true;
+}
+
+// Header written by save_model: input shape (version 2), output head and class names
+static bool read_model_header(FILE *file, InputShape &shape, OutputHead &head, std::vector<std::string> &names) {
+    unsigned int version, classes;
+    int stored_head;
+    if (fread(&version, sizeof(version), 1, file) != 1 || version < 1 || version > model_version) {
+        return false;
+    }
+    if (version >= 2) {
+        int stored[2];
+        if (fread(stored, sizeof(int), 2, file) != 2) {
+            return false;
+        }
+        shape = InputShape(stored[0], stored[1]);
+        if (!shape.valid()) {
+            return false;
+        }
+    }
+    if (fread(&stored_head, sizeof(stored_head), 1, file) != 1 ||
+        (stored_head != HEAD_SIGMOID && stored_head != HEAD_SOFTMAX) ||
+        fread(&classes, sizeof(classes), 1, file) != 1 || classes < 2 || classes > 65536) {
+        return false;
+    }
+    names.resize(classes);
+    for (std::string &name : names) {
+        unsigned int len;
+        if (fread(&len, sizeof(len), 1, file) != 1 || len > 4096) {
+            return false;
+        }
+        name.resize(len);
+        if (len > 0 && fread(&name[0], 1, len, file) != len) {
+            return false;
+        }
+    }
+    head = (OutputHead)stored_head;
+    return true;
+}
+
+// Load model weights from file
+bool load_model(Network &net, const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        return false;
+    }
+
+    // Files without the magic are the original 3-class weights-only layout
+    // on 28x28 grayscale
+    InputShape shape;
+    OutputHead head = net.head;
+    std::vector<std::string> names = legacy_classes();
+    char magic[4];
+    if (fread(magic, 1, 4, file) == 4 && memcmp(magic, model_magic, 4) == 0) {
+        if (!read_model_header(file, shape, head, names)) {
+            fclose(file);
+            return false;
+        }
+    } else {
+        rewind(file);
+    }
+
+    // Read into a separate network and swap it in only once the whole file
+    // was read, so a truncated or corrupt file leaves `net` as it was
+    Network loaded(names, shape);
+    loaded.head = head;
+    loaded.optimizer = net.optimizer;
+    bool ok = read_floats(file, loaded.l_c1.weight, loaded.l_c1.M * loaded.l_c1.N) &&  // convolution layer
+              read_floats(file, loaded.l_c1.bias, loaded.l_c1.N) &&
+              read_floats(file, loaded.l_s1.weight, loaded.l_s1.M * loaded.l_s1.N) &&  // pooling layer
+              read_floats(file, loaded.l_s1.bias, loaded.l_s1.N) &&
+              read_floats(file, loaded.l_f.weight, loaded.l_f.M * loaded.l_f.N) &&     // fully connected layer
+              read_floats(file, loaded.l_f.bias, loaded.l_f.N) &&
+              read_optimizer_state(file, loaded);
+
+    fclose(file);
+    if (ok) {
+        net.swap(loaded);
+    }
+    return ok;
+}
+
+// Test a single custom image
+void test_single_image(Network &net, const float *input) {
+    forward_pass(net, input);
+    print_prediction(net, net.l_f.output);
+}
+
+void print_prediction(const Network &net, const float *scores) {
+    unsigned int prediction = 0;
+    for (int i = 1; i < net.num_classes(); ++i) {
+        if (scores[prediction] < scores[i]) {
+            prediction = i;
+        }
+    }
+
+    fprintf(stdout, "\n=== Prediction Results ===\n");
+    fprintf(stdout, "Predicted class: %s (label %d)\n", net.class_names[prediction].c_str(), prediction);
+    fprintf(stdout, "\nConfidence scores:\n");
+    for (int i = 0; i < net.num_classes(); i++) {
+        fprintf(stdout, "  %s: %.4f\n", net.class_names[i].c_str(), scores[i]);
+    }
+    fprintf(stdout, "========================\n\n");
+}
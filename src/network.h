@@ -0,0 +1,155 @@
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include "layer.h"
+#include "image_loader.h"
+#include "rng.h"
+#include "augment.h"
+#include "conv_engine.h"
+#include <string>
+#include <vector>
+
+// Activation/loss of the output layer
+enum OutputHead {
+    HEAD_SIGMOID = 0,  // sigmoid outputs, squared-error style target (makeError)
+    HEAD_SOFTMAX = 1   // softmax outputs, cross-entropy loss (softmax_ce_grad)
+};
+
+// Define layers of CNN (one output per class)
+struct Network {
+    const float *input;  // of the last forward_pass, read in place by back_pass
+    Layer l_c1;
+    Layer l_s1;
+    Layer l_f;
+    OutputHead head;
+    Optimizer optimizer;
+    std::vector<std::string> class_names;  // label -> class name
+    InputShape shape;                      // input resolution and channels
+
+    Network();  // the original 3 classes (Belts, Shoes, Watch) on 28x28 grayscale, weights initialized with seed 0
+    explicit Network(const std::vector<std::string> &classes, const InputShape &shape = InputShape());
+
+    int num_classes() const { return l_f.N; }
+    // Size the output layer for `classes`; its weights must be re-initialized or loaded
+    void set_classes(const std::vector<std::string> &classes);
+    // Size every layer for `shape`; all weights must be re-initialized or loaded
+    void set_shape(const InputShape &shape);
+    // Re-draw all weights and biases from --seed
+    void init_weights(unsigned int seed);
+    // Keep only the weights and biases (cnn_infer). Only infer() works
+    // afterwards; set_shape or loading another shape reallocates the rest.
+    void release_training();
+    // Bytes of all layer buffers currently allocated
+    size_t allocated_bytes() const;
+    // Exchange layers, head, optimizer, classes and shape with `other`
+    void swap(Network &other);
+
+  private:
+    Network(const Network &);
+    Network &operator=(const Network &);
+};
+
+struct Checkpoint;
+class ShardStream;
+
+// Training options set from the command line
+struct TrainOptions {
+    int epochs;          // --epochs
+    unsigned int seed;   // --seed (initialization, split, shuffle and augmentation)
+    float target_accuracy;  // --target-accuracy: stop once test accuracy (%) reaches it, 0 = off
+    float learning_rate;    // --lr: initial learning rate, 0 = default for the optimizer
+    const char *checkpoint_path;   // --checkpoint
+    int checkpoint_every;          // --checkpoint-every: epochs between checkpoints, 0 = off
+    const Checkpoint *resume_from; // --resume: continue after this checkpoint (already restored into the network)
+    int val_every;   // --val-every: validate every K epochs, 0 = off
+    int patience;    // --patience: stop after this many validations without improvement, 0 = never
+    int pipeline_batch;  // --pipeline-batch: samples per prepared batch
+    bool pipeline_async; // --no-pipeline clears it: prepare samples on the training thread
+    AugmentOptions augment;  // --augment (applied from epoch 11 on)
+    ShardStream *train_stream;  // --stream: train from this stream instead of the train set
+    ShardStream *eval_stream;   // --stream: held-out set for --target-accuracy
+    const ByteImages *train_bytes;  // --mnist: train from these images instead of the train set
+    const ByteImages *eval_bytes;   // --mnist: held-out set for --target-accuracy
+
+    TrainOptions()
+        : epochs(80), seed(0), target_accuracy(0), learning_rate(0),
+          checkpoint_path("cnn_checkpoint.bin"), checkpoint_every(0), resume_from(nullptr),
+          val_every(0), patience(0), pipeline_batch(64), pipeline_async(true),
+          train_stream(nullptr), eval_stream(nullptr), train_bytes(nullptr), eval_bytes(nullptr) {}
+};
+
+// Per-layer time spent in forward + backward passes (ms, wall clock)
+extern double total_convolution_time, total_pooling_time, total_fully_connected_time, total_gradient_time;
+
+// End-to-end throughput measurements (wall clock)
+extern double train_seconds, infer_seconds;
+extern unsigned long train_samples, infer_samples;
+
+// Activations of batched inference (evaluate / test); the buffers grow to
+// the largest batch seen. Activations are applied in place, so each layer
+// needs one tensor: the convolution runs into ping, the pooling into pong.
+struct BatchWorkspace {
+    std::vector<const float *> samples;  // n inputs of shape.pixels() floats, read in place
+    Tensor input;  // storage for samples that have to be converted first (8-bit)
+    Tensor ping, pong;
+    std::vector<float> f_weight;  // l_f weights packed for pong's layout
+    std::vector<float> scores;    // [n][classes]
+};
+
+// Inference-only execution of one sample. Each layer writes its preact into
+// one of two ping-pong buffers and applies the activation in place, so a
+// request touches the weights and two activation buffers instead of every
+// layer's preact and output, and no gradient or optimizer state is needed.
+struct InferencePlan {
+    std::vector<float> ping, pong;  // convolution and scores / pooling
+    size_t train_bytes;    // all layer buffers of the network as trained
+    size_t forward_bytes;  // weights and activations forward_pass touches per request
+    size_t plan_bytes;     // weights and activations infer touches per request
+};
+
+extern TensorLayout infer_layout;  // --layout: activation layout of batched inference
+extern int infer_batch;            // --infer-batch: samples per batched forward pass
+extern ConvEngine conv_engine;     // --conv: first layer engine of batched inference (nchw layout)
+
+// input is net.shape.pixels() floats, planar, read in place; it has to stay
+// valid until back_pass
+double forward_pass(Network &net, const float *input);
+double back_pass(Network &net);
+// One optimizer step (opt.kind) of a parameter tensor, its descent direction and state
+void optimizer_step(const Optimizer &opt, float *param, float *grad, float *m, float *v, int n);
+// eval_set is the held-out set for --target-accuracy and validation
+// (--val-every / --patience); the best validated weights are kept at the end
+void learn(Network &net, image_data *train_set, unsigned int train_cnt, const TrainOptions &opts,
+           image_data *eval_set = nullptr, unsigned int eval_cnt = 0);
+unsigned int classify(Network &net, const float *input);
+// Size the plan's buffers for net and measure the working sets (call before release_training)
+void plan_inference(const Network &net, InferencePlan &plan);
+// Class scores for input (valid until the next call); same values as forward_pass
+const float *infer(const Network &net, InferencePlan &plan, const float *input);
+unsigned int classify(const Network &net, InferencePlan &plan, const float *input);
+// Forward pass of the samples in ws.samples, in infer_layout
+void forward_batch(Network &net, BatchWorkspace &ws);
+void classify_batch(Network &net, BatchWorkspace &ws, unsigned int *predictions);
+// Accuracy in percent, without printing
+double evaluate(Network &net, image_data *set, unsigned int cnt);
+double evaluate(Network &net, ShardStream &stream);
+double evaluate(Network &net, const ByteImages &set);
+void test(Network &net, image_data *test_set, unsigned int test_cnt);
+void test(Network &net, ShardStream &stream);  // streams the records in file order
+void test(Network &net, const ByteImages &set);
+void test_single_image(Network &net, const float *input);
+// The predicted class and every class score
+void print_prediction(const Network &net, const float *scores);
+// Accuracy summary and confusion matrix ([actual][predicted]) of a test run
+void print_test_results(const std::vector<std::string> &class_names, const std::vector<int> &confusion_matrix,
+                        unsigned int test_cnt);
+
+// Header (magic, input shape, output head, class names), weights and
+// biases, then the optimizer state unless it is plain SGD. load_model resizes
+// the network to the shape and classes in the file and also reads version 1
+// files (28x28 grayscale) and the original headerless 3-class files. On
+// failure `net` is left unchanged.
+void save_model(Network &net, const char *filename);
+bool load_model(Network &net, const char *filename);
+
+#endif // NETWORK_H
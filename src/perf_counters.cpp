@@ -0,0 +1,207 @@
+#include "perf_counters.h"
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char *perf_kernel_names[PK_NUM_KERNELS] = {
+    "fp_c1", "fp_s1", "fp_f", "bp_f", "bp_s1",
+    "bp_output_c1", "bp_preact_c1", "bp_weight_c1", "bp_bias_c1", "apply_grad"
+};
+
+// Floating point operations per call (multiply and add counted separately,
+// sigmoid counted as 4 ops), for the shape given to perf_set_shape. Used
+// only for the GFLOP/s estimate.
+static double perf_kernel_flops[PK_NUM_KERNELS];
+
+void perf_set_shape(const InputShape &shape, int classes) {
+    double c1 = 6.0 * shape.conv_size() * shape.conv_size();  // convolution outputs
+    double s1 = shape.features();                             // pooling outputs
+    double taps = 5 * 5 * shape.channels;
+    double k = classes;
+    perf_kernel_flops[PK_FP_C1] = c1 * (taps * 2 + 1) + c1 * 4;                  // fp_c1 + sigmoid
+    perf_kernel_flops[PK_FP_S1] = s1 * (4 * 4 * 2 + 1) + s1 * 4;                 // fp_s1 + sigmoid
+    perf_kernel_flops[PK_FP_F] = k * s1 * 2 + k + k * 4;                         // fp_preact_f + fp_bias_f + sigmoid
+    perf_kernel_flops[PK_BP_F] = k * s1 + k * 2;                                 // bp_weight_f + bp_bias_f
+    perf_kernel_flops[PK_BP_S1] = k * s1 * 2 + s1 * 7 + 16 * s1 * 2 + s1 + 3;   // bp_output/preact/weight/bias_s1
+    perf_kernel_flops[PK_BP_OUTPUT_C1] = 16 * s1 * 2;                            // bp_output_c1
+    perf_kernel_flops[PK_BP_PREACT_C1] = c1 * 10;                                // bp_preact_c1 (two sigmoids)
+    perf_kernel_flops[PK_BP_WEIGHT_C1] = taps * c1 * 3;                          // bp_weight_c1
+    perf_kernel_flops[PK_BP_BIAS_C1] = c1 + 6 * 3;                               // bp_bias_c1
+    perf_kernel_flops[PK_APPLY_GRAD] = (k * s1 + 16 + 6 * taps) * 2;             // apply_grad on all layers
+}
+
+struct PerfReading {
+    unsigned long long count[PERF_NUM_EVENTS];
+    double seconds;
+};
+
+struct PerfTotals {
+    unsigned long long count[PERF_NUM_EVENTS];
+    double seconds;
+    double flops;
+    unsigned long long calls;
+};
+
+bool perf_enabled = false;
+static int perf_fd[PERF_NUM_EVENTS] = {-1, -1, -1, -1, -1};
+static PerfTotals perf_kernel_totals[PK_NUM_KERNELS];
+static PerfReading perf_kernel_start[PK_NUM_KERNELS];
+static PerfReading perf_epoch_start;
+static double perf_epoch_flops = 0.0;
+
+static double perf_now() {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef __linux__
+static int perf_open_event(unsigned int type, unsigned long long config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = type;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.inherit = 1;         // follow OpenMP worker threads
+    attr.exclude_kernel = 1;  // allowed with perf_event_paranoid <= 2
+    attr.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+// Open the counters. Must be called before the first OpenMP parallel region
+// so the worker threads inherit them. Returns the number of events opened.
+int perf_init() {
+    int opened = 0;
+    memset(perf_kernel_totals, 0, sizeof(perf_kernel_totals));
+    perf_set_shape(InputShape(), 3);
+#ifdef __linux__
+    const unsigned long long l1d_miss = PERF_COUNT_HW_CACHE_L1D |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    perf_fd[PERF_CYCLES] = perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    perf_fd[PERF_INSTRUCTIONS] = perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    perf_fd[PERF_L1D_MISSES] = perf_open_event(PERF_TYPE_HW_CACHE, l1d_miss);
+    perf_fd[PERF_LLC_MISSES] = perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    perf_fd[PERF_BRANCH_MISSES] = perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+        if (perf_fd[e] >= 0) opened++;
+    }
+#endif
+    perf_enabled = true;
+    if (opened == 0) {
+        fprintf(stderr, "Warning: hardware performance counters unavailable, "
+                        "reporting timing and GFLOP/s only\n");
+    } else if (opened < PERF_NUM_EVENTS) {
+        fprintf(stderr, "Warning: only %d of %d performance counters available\n",
+                opened, PERF_NUM_EVENTS);
+    }
+    return opened;
+}
+
+void perf_close() {
+#ifdef __linux__
+    for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+        if (perf_fd[e] >= 0) close(perf_fd[e]);
+        perf_fd[e] = -1;
+    }
+#endif
+    perf_enabled = false;
+}
+
+static void perf_read(PerfReading *r) {
+    for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+        r->count[e] = 0;
+#ifdef __linux__
+        if (perf_fd[e] >= 0) {
+            unsigned long long v = 0;
+            if (read(perf_fd[e], &v, sizeof(v)) == sizeof(v)) r->count[e] = v;
+        }
+#endif
+    }
+    r->seconds = perf_now();
+}
+
+void perf_kernel_begin(PerfKernel k) {
+    perf_read(&perf_kernel_start[k]);
+}
+
+void perf_kernel_end(PerfKernel k) {
+    PerfReading now;
+    perf_read(&now);
+    PerfTotals &t = perf_kernel_totals[k];
+    for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+        t.count[e] += now.count[e] - perf_kernel_start[k].count[e];
+    }
+    t.seconds += now.seconds - perf_kernel_start[k].seconds;
+    t.flops += perf_kernel_flops[k];
+    t.calls++;
+    perf_epoch_flops += perf_kernel_flops[k];
+}
+
+static void perf_format_count(char *buf, size_t n, PerfEvent e, unsigned long long v) {
+    if (perf_fd[e] < 0) snprintf(buf, n, "n/a");
+    else snprintf(buf, n, "%llu", v);
+}
+
+static void perf_format_ipc(char *buf, size_t n, const unsigned long long *count) {
+    if (perf_fd[PERF_CYCLES] < 0 || perf_fd[PERF_INSTRUCTIONS] < 0 || count[PERF_CYCLES] == 0) {
+        snprintf(buf, n, "n/a");
+    } else {
+        snprintf(buf, n, "%.2f", (double)count[PERF_INSTRUCTIONS] / count[PERF_CYCLES]);
+    }
+}
+
+void perf_epoch_begin() {
+    if (!perf_enabled) return;
+    perf_epoch_flops = 0.0;
+    perf_read(&perf_epoch_start);
+}
+
+void perf_epoch_end(int epoch) {
+    if (!perf_enabled) return;
+    PerfReading now;
+    perf_read(&now);
+    unsigned long long delta[PERF_NUM_EVENTS];
+    for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+        delta[e] = now.count[e] - perf_epoch_start.count[e];
+    }
+    double seconds = now.seconds - perf_epoch_start.seconds;
+
+    char ipc[32], l1d[32], llc[32], br[32];
+    perf_format_ipc(ipc, sizeof(ipc), delta);
+    perf_format_count(l1d, sizeof(l1d), PERF_L1D_MISSES, delta[PERF_L1D_MISSES]);
+    perf_format_count(llc, sizeof(llc), PERF_LLC_MISSES, delta[PERF_LLC_MISSES]);
+    perf_format_count(br, sizeof(br), PERF_BRANCH_MISSES, delta[PERF_BRANCH_MISSES]);
+    fprintf(stdout, "  perf epoch %3d - IPC: %s, L1D misses: %s, LLC misses: %s, "
+                    "branch misses: %s, %.3f GFLOP/s\n",
+            epoch, ipc, l1d, llc, br,
+            seconds > 0 ? perf_epoch_flops / seconds * 1e-9 : 0.0);
+}
+
+void perf_report() {
+    if (!perf_enabled) return;
+    fprintf(stdout, "\n=== Performance Counters (per kernel) ===\n");
+    fprintf(stdout, "%-14s %10s %12s %16s %8s %14s %14s %14s %10s\n",
+            "kernel", "calls", "time (ms)", "cycles", "IPC",
+            "L1D misses", "LLC misses", "branch misses", "GFLOP/s");
+    for (int k = 0; k < PK_NUM_KERNELS; ++k) {
+        const PerfTotals &t = perf_kernel_totals[k];
+        if (t.calls == 0) continue;
+        char cyc[32], ipc[32], l1d[32], llc[32], br[32];
+        perf_format_count(cyc, sizeof(cyc), PERF_CYCLES, t.count[PERF_CYCLES]);
+        perf_format_ipc(ipc, sizeof(ipc), t.count);
+        perf_format_count(l1d, sizeof(l1d), PERF_L1D_MISSES, t.count[PERF_L1D_MISSES]);
+        perf_format_count(llc, sizeof(llc), PERF_LLC_MISSES, t.count[PERF_LLC_MISSES]);
+        perf_format_count(br, sizeof(br), PERF_BRANCH_MISSES, t.count[PERF_BRANCH_MISSES]);
+        fprintf(stdout, "%-14s %10llu %12.2f %16s %8s %14s %14s %14s %10.3f\n",
+                perf_kernel_names[k], t.calls, t.seconds * 1000.0, cyc, ipc, l1d, llc, br,
+                t.seconds > 0 ? t.flops / t.seconds * 1e-9 : 0.0);
+    }
+    fprintf(stdout, "=========================================\n");
+}
+
@@ -0,0 +1,64 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// Optional hardware performance counters for the CNN kernels.
+//
+// Enabled with --perf. Uses Linux perf_event_open to count cycles,
+// instructions, L1D/LLC misses and branch misses in user space, per kernel
+// and per epoch. Counters are opened with inherit=1 before any worker thread
+// is started, so OpenMP threads are included in the totals. Events the
+// machine (or the container) does not expose are reported as "n/a".
+
+#include "input_shape.h"
+
+enum PerfEvent {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_NUM_EVENTS
+};
+
+enum PerfKernel {
+    PK_FP_C1 = 0,
+    PK_FP_S1,
+    PK_FP_F,
+    PK_BP_F,
+    PK_BP_S1,
+    PK_BP_OUTPUT_C1,
+    PK_BP_PREACT_C1,
+    PK_BP_WEIGHT_C1,
+    PK_BP_BIAS_C1,
+    PK_APPLY_GRAD,
+    PK_NUM_KERNELS
+};
+
+extern bool perf_enabled;
+
+// Open the counters. Must be called before the first OpenMP parallel region
+// so the worker threads inherit them. Returns the number of events opened.
+int perf_init();
+void perf_close();
+
+void perf_kernel_begin(PerfKernel k);
+void perf_kernel_end(PerfKernel k);
+
+static inline void perf_begin(PerfKernel k) {
+    if (perf_enabled) perf_kernel_begin(k);
+}
+
+static inline void perf_end(PerfKernel k) {
+    if (perf_enabled) perf_kernel_end(k);
+}
+
+// Size the GFLOP/s estimate for the network (28x28 grayscale, 3 classes after perf_init)
+void perf_set_shape(const InputShape &shape, int classes);
+
+void perf_epoch_begin();
+void perf_epoch_end(int epoch);
+
+// Print the per-kernel table (no-op unless perf_init was called)
+void perf_report();
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,68 @@
+#include "rng.h"
+
+// splitmix64: expands a 64-bit seed into well mixed state words
+static uint64_t splitmix64(uint64_t &x) {
+    uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static void seed_state(uint32_t state[4], uint64_t seed, uint64_t stream) {
+    uint64_t x = seed ^ (stream * 0xD1B54A32D192ED03ull);
+    uint64_t a = splitmix64(x), b = splitmix64(x);
+    state[0] = (uint32_t)a;
+    state[1] = (uint32_t)(a >> 32);
+    state[2] = (uint32_t)b;
+    state[3] = (uint32_t)(b >> 32);
+    // xoshiro must not start from the all-zero state
+    if ((state[0] | state[1] | state[2] | state[3]) == 0) {
+        state[0] = 1;
+    }
+}
+
+void Rng::reseed(uint64_t seed, uint64_t stream) {
+    seed_state(s, seed, stream);
+}
+
+void BulkRng::reseed(uint64_t seed, uint64_t stream) {
+    for (int lane = 0; lane < LANES; ++lane) {
+        uint32_t state[4];
+        seed_state(state, seed, stream * LANES + lane);
+        for (int k = 0; k < 4; ++k) {
+            s[k][lane] = state[k];
+        }
+    }
+}
+
+void BulkRng::fill_uniform(float *out, int n, float lo, float hi) {
+    const float scale = (hi - lo) * (1.0f / 16777216.0f);
+    uint32_t s0[LANES], s1[LANES], s2[LANES], s3[LANES];
+    for (int l = 0; l < LANES; ++l) {
+        s0[l] = s[0][l]; s1[l] = s[1][l]; s2[l] = s[2][l]; s3[l] = s[3][l];
+    }
+
+    for (int i = 0; i < n; i += LANES) {
+        float block[LANES];
+        #pragma omp simd
+        for (int l = 0; l < LANES; ++l) {
+            uint32_t result = s0[l] + s3[l];
+            uint32_t t = s1[l] << 9;
+            s2[l] ^= s0[l];
+            s3[l] ^= s1[l];
+            s1[l] ^= s2[l];
+            s0[l] ^= s3[l];
+            s2[l] ^= t;
+            s3[l] = (s3[l] << 11) | (s3[l] >> 21);
+            block[l] = lo + (float)(result >> 8) * scale;
+        }
+        int m = (n - i < LANES) ? n - i : LANES;
+        for (int l = 0; l < m; ++l) {
+            out[i + l] = block[l];
+        }
+    }
+
+    for (int l = 0; l < LANES; ++l) {
+        s[0][l] = s0[l]; s[1][l] = s1[l]; s[2][l] = s2[l]; s[3][l] = s3[l];
+    }
+}
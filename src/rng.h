@@ -0,0 +1,73 @@
+#ifndef RNG_H
+#define RNG_H
+
+// Small, lock-free random number generators.
+//
+// Rng is xoshiro128+ (Blackman & Vigna): 16 bytes of state, one add, a few
+// shifts and xors per 32-bit output, seeded through splitmix64 from a
+// (seed, stream) pair so every consumer of --seed gets its own independent,
+// reproducible sequence. Unlike rand() there is no hidden global state or
+// lock: each thread owns the generators it draws from.
+//
+// BulkRng runs eight xoshiro128+ streams in lockstep with the state stored
+// lane-major, so fill_uniform() vectorizes and produces eight floats per step
+// (augmentation noise).
+
+#include <cstdint>
+
+// Stream ids, so the same --seed gives unrelated sequences per use
+enum RngStream {
+    RNG_STREAM_INIT = 1,     // Layer weight initialization
+    RNG_STREAM_SPLIT = 2,    // train/test split shuffle
+    RNG_STREAM_AUGMENT = 3,  // augmentation decisions
+    RNG_STREAM_NOISE = 4,    // augmentation noise (BulkRng)
+    RNG_STREAM_SHUFFLE = 5   // streaming dataset shard order and shuffle window
+};
+
+struct Rng {
+    uint32_t s[4];
+
+    explicit Rng(uint64_t seed = 0, uint64_t stream = 0) { reseed(seed, stream); }
+    void reseed(uint64_t seed, uint64_t stream = 0);
+
+    uint32_t next() {
+        uint32_t result = s[0] + s[3];
+        uint32_t t = s[1] << 9;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = (s[3] << 11) | (s[3] >> 21);
+        return result;
+    }
+
+    // Uniform in [0, 1) from the 24 high bits
+    float uniform() { return (next() >> 8) * (1.0f / 16777216.0f); }
+
+    // Uniform integer in [0, n), n > 0 (multiply-shift, no division)
+    uint32_t below(uint32_t n) { return (uint32_t)(((uint64_t)next() * n) >> 32); }
+};
+
+struct BulkRng {
+    enum { LANES = 8 };
+    uint32_t s[4][LANES];
+
+    explicit BulkRng(uint64_t seed = 0, uint64_t stream = 0) { reseed(seed, stream); }
+    void reseed(uint64_t seed, uint64_t stream = 0);
+
+    // out[i] uniform in [lo, hi)
+    void fill_uniform(float *out, int n, float lo, float hi);
+};
+
+// Everything the training-data augmentation draws from; plain data, so a
+// checkpoint can store it as raw bytes
+struct AugmentRng {
+    Rng coin;       // which samples are augmented and how
+    BulkRng noise;  // per-pixel noise
+
+    explicit AugmentRng(uint64_t seed = 0)
+        : coin(seed, RNG_STREAM_AUGMENT), noise(seed, RNG_STREAM_NOISE) {}
+};
+
+#endif // RNG_H
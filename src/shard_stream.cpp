@@ -0,0 +1,293 @@
+#include "shard_stream.h"
+#include "image_loader.h"
+#include "cnn_helper.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Shard file: magic, u32 record count, then the records
+static const char shard_magic[4] = {'V', 'S', 'S', 'H'};
+
+// Readahead depth: shards loaded ahead of the one being consumed
+static const size_t shard_readahead = 2;
+
+static std::string shard_path(const char *cache_dir, const char *split, unsigned int index) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s-%05u.shard", cache_dir, split, index);
+    return path;
+}
+
+// Writes records of one split, starting a new shard every shard_records
+struct ShardWriter {
+    const char *cache_dir;
+    const char *split;
+    unsigned int shards;
+    unsigned int in_shard;
+    FILE *file;
+
+    ShardWriter(const char *cache_dir, const char *split)
+        : cache_dir(cache_dir), split(split), shards(0), in_shard(0), file(nullptr) {}
+
+    bool close() {
+        if (!file) {
+            return true;
+        }
+        // Patch the record count into the header
+        bool ok = fseek(file, sizeof(shard_magic), SEEK_SET) == 0 &&
+                  fwrite(&in_shard, sizeof(in_shard), 1, file) == 1;
+        ok = fclose(file) == 0 && ok;
+        file = nullptr;
+        return ok;
+    }
+
+    bool write(const ShardRecord &record) {
+        if (file && in_shard == shard_records && !close()) {
+            return false;
+        }
+        if (!file) {
+            std::string path = shard_path(cache_dir, split, shards++);
+            file = fopen(path.c_str(), "wb");
+            in_shard = 0;
+            if (!file || fwrite(shard_magic, sizeof(shard_magic), 1, file) != 1 ||
+                fwrite(&in_shard, sizeof(in_shard), 1, file) != 1) {
+                fprintf(stderr, "Error: cannot write shard %s\n", path.c_str());
+                return false;
+            }
+        }
+        in_shard++;
+        return fwrite(&record, sizeof(record), 1, file) == 1;
+    }
+};
+
+int build_shard_cache(const char *data_dir, const std::vector<std::string> &classes,
+                      const char *cache_dir, unsigned int seed) {
+    double start = wall_seconds();
+#ifdef _WIN32
+    _mkdir(cache_dir);
+#else
+    mkdir(cache_dir, 0755);
+#endif
+
+    // Only the paths are held in memory
+    std::vector<std::string> files;
+    std::vector<uint32_t> labels;
+    char dir_path[512];
+    for (size_t label = 0; label < classes.size(); ++label) {
+        snprintf(dir_path, sizeof(dir_path), "%s/%s", data_dir, classes[label].c_str());
+        int found = list_image_files(dir_path, files);
+        labels.resize(files.size(), (uint32_t)label);
+        fprintf(stdout, "Found %d images in %s (label %d)\n", found, classes[label].c_str(), (int)label);
+    }
+    if (files.empty()) {
+        fprintf(stderr, "Error: No images found in %s\n", data_dir);
+        return -1;
+    }
+
+    // split_dataset's shuffle and 80/20 cut, applied to every file found
+    // (split_dataset only sees the images that decode)
+    Rng rng(seed, RNG_STREAM_SPLIT);
+    for (size_t i = files.size() - 1; i > 0; i--) {
+        size_t j = rng.below(i + 1);
+        std::swap(files[i], files[j]);
+        std::swap(labels[i], labels[j]);
+    }
+    size_t train_cnt = (size_t)(files.size() * 0.8);
+
+    ShardWriter train_writer(cache_dir, "train");
+    ShardWriter test_writer(cache_dir, "test");
+    size_t written[2] = {0, 0}, failed = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        ShardRecord record;
+        if (decode_image(files[i].c_str(), InputShape(), record.pixels) != 0) {
+            fprintf(stderr, "Warning: Failed to load %s\n", files[i].c_str());
+            failed++;
+            continue;
+        }
+        record.label = labels[i];
+        bool test = i >= train_cnt;
+        if (!(test ? test_writer : train_writer).write(record)) {
+            fprintf(stderr, "Error: writing the shard cache in %s failed\n", cache_dir);
+            return -1;
+        }
+        written[test]++;
+    }
+    if (!train_writer.close() || !test_writer.close()) {
+        fprintf(stderr, "Error: writing the shard cache in %s failed\n", cache_dir);
+        return -1;
+    }
+
+    char manifest_path[512];
+    snprintf(manifest_path, sizeof(manifest_path), "%s/classes.txt", cache_dir);
+    FILE *manifest = fopen(manifest_path, "w");
+    if (!manifest) {
+        fprintf(stderr, "Error: cannot write %s\n", manifest_path);
+        return -1;
+    }
+    fprintf(manifest, "# Shard cache of %s, split with seed %u\n", data_dir, seed);
+    for (size_t c = 0; c < classes.size(); ++c) {
+        fprintf(manifest, "%s\n", classes[c].c_str());
+    }
+    fclose(manifest);
+
+    fprintf(stdout, "Cached %zu train / %zu test images into %u + %u shards in %s (%.2lf s)\n",
+            written[0], written[1], train_writer.shards, test_writer.shards, cache_dir,
+            wall_seconds() - start);
+    if (failed) {
+        fprintf(stderr, "Warning: %zu images failed to decode, so this split differs from the in-memory "
+                        "loader's for seed %u\n", failed, seed);
+    }
+    return 0;
+}
+
+bool shard_cache_exists(const char *cache_dir) {
+    char manifest_path[512];
+    snprintf(manifest_path, sizeof(manifest_path), "%s/classes.txt", cache_dir);
+    FILE *manifest = fopen(manifest_path, "r");
+    if (manifest) {
+        fclose(manifest);
+    }
+    return manifest != nullptr;
+}
+
+// Header of a shard file; 0 if it is missing or malformed
+static uint32_t read_shard_header(FILE *file) {
+    char magic[4];
+    uint32_t count;
+    if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, shard_magic, sizeof(magic)) != 0 ||
+        fread(&count, sizeof(count), 1, file) != 1) {
+        return 0;
+    }
+    return count;
+}
+
+ShardStream::ShardStream(const char *cache_dir, const char *split, int window)
+    : read_seconds(0), wait_seconds(0), total(0), window_size(window > 1 ? window : 1), position(0),
+      next_shard(0), consumed(0), generation(0), stopping(false) {
+    for (unsigned int index = 0;; ++index) {
+        std::string path = shard_path(cache_dir, split, index);
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file) {
+            break;
+        }
+        total += read_shard_header(file);
+        fclose(file);
+        paths.push_back(path);
+    }
+    this->window.reserve(window_size);
+    worker = std::thread(&ShardStream::run, this);
+}
+
+ShardStream::~ShardStream() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    cond.notify_all();
+    worker.join();
+}
+
+void ShardStream::begin_epoch(unsigned int seed) {
+    std::lock_guard<std::mutex> guard(lock);
+    shard_order.resize(paths.size());
+    for (size_t i = 0; i < shard_order.size(); ++i) {
+        shard_order[i] = (int)i;
+    }
+    rng.reseed(seed, RNG_STREAM_SHUFFLE);
+    if (window_size > 1) {
+        for (size_t i = shard_order.size(); i > 1; i--) {
+            std::swap(shard_order[i - 1], shard_order[rng.below(i)]);
+        }
+    }
+    generation++;
+    next_shard = 0;
+    consumed = 0;
+    loaded.clear();
+    current.clear();
+    position = 0;
+    window.clear();
+    cond.notify_all();
+}
+
+// Next record in shard order
+bool ShardStream::pull(ShardRecord &out) {
+    while (position >= current.size()) {
+        std::unique_lock<std::mutex> guard(lock);
+        if (consumed >= shard_order.size()) {
+            return false;
+        }
+        double start = wall_seconds();
+        cond.wait(guard, [this] { return !loaded.empty(); });
+        wait_seconds += wall_seconds() - start;
+        current.swap(loaded.front());
+        loaded.pop_front();
+        consumed++;
+        position = 0;
+        cond.notify_all();
+    }
+    out = current[position++];
+    return true;
+}
+
+bool ShardStream::next(ShardRecord &out) {
+    // Keep the window full, then hand out a random member of it
+    while ((int)window.size() < window_size) {
+        window.resize(window.size() + 1);
+        if (!pull(window.back())) {
+            window.pop_back();
+            break;
+        }
+    }
+    if (window.empty()) {
+        return false;
+    }
+    size_t pick = window_size > 1 ? rng.below(window.size()) : 0;
+    out = window[pick];
+    window[pick] = window.back();
+    window.pop_back();
+    return true;
+}
+
+void ShardStream::run() {
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        cond.wait(guard, [this] {
+            return stopping || (next_shard < shard_order.size() && loaded.size() < shard_readahead);
+        });
+        if (stopping) {
+            break;
+        }
+        unsigned int read_generation = generation;
+        std::string path = paths[shard_order[next_shard++]];
+
+        guard.unlock();
+        double start = wall_seconds();
+        std::vector<ShardRecord> records;
+        FILE *file = fopen(path.c_str(), "rb");
+        if (file) {
+            records.resize(read_shard_header(file));
+            if (fread(records.data(), sizeof(ShardRecord), records.size(), file) != records.size()) {
+                fprintf(stderr, "Warning: shard %s is truncated\n", path.c_str());
+                records.clear();
+            }
+            fclose(file);
+        } else {
+            fprintf(stderr, "Warning: cannot read shard %s\n", path.c_str());
+        }
+        double elapsed = wall_seconds() - start;
+        guard.lock();
+        read_seconds += elapsed;
+
+        // begin_epoch ran meanwhile: this shard belongs to the old order
+        if (read_generation == generation) {
+            loaded.push_back(std::vector<ShardRecord>());
+            loaded.back().swap(records);
+            cond.notify_all();
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef SHARD_STREAM_H
+#define SHARD_STREAM_H
+
+// Streaming dataset for catalogs larger than RAM.
+//
+// build_shard_cache decodes the catalog one image at a time into a cache
+// directory of fixed-size shard files holding 28x28 8-bit grayscale pixels
+// (788 bytes per image instead of 3 KB of floats in memory), already split into
+// train-*.shard and test-*.shard. ShardStream then reads the shards of a
+// split sequentially, with a background thread reading the next shard
+// while the current one is consumed, and shuffles records inside a bounded
+// window. Memory stays at a few shards plus the window, whatever the
+// dataset size.
+
+#include "rng.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records per shard file (about 3 MB)
+const static unsigned int shard_records = 4096;
+
+struct ShardRecord {
+    uint32_t label;
+    uint8_t pixels[28 * 28];
+};
+
+// Decode the images of `classes` under data_dir into cache_dir. The file
+// list is shuffled with split_dataset's permutation and cut 80/20 before
+// decoding, so when every image decodes a given seed selects the same test
+// images as the in-memory loader. Images that fail are dropped after the
+// cut, while split_dataset shuffles only the images that loaded, so with
+// failures the splits differ (the build warns). classes.txt is written
+// last and marks a complete cache.
+int build_shard_cache(const char *data_dir, const std::vector<std::string> &classes,
+                      const char *cache_dir, unsigned int seed);
+
+// True once build_shard_cache has completed for cache_dir
+bool shard_cache_exists(const char *cache_dir);
+
+class ShardStream {
+  public:
+    // split is "train" or "test"; window <= 1 streams the records in file order
+    ShardStream(const char *cache_dir, const char *split, int window);
+    ~ShardStream();
+
+    bool ok() const { return !paths.empty(); }
+    size_t count() const { return total; }
+
+    // Restart from the first shard. With a window, the shard order and the
+    // window draws are shuffled from seed.
+    void begin_epoch(unsigned int seed);
+    // Next record of the epoch; false once it is exhausted
+    bool next(ShardRecord &out);
+
+    double read_seconds;  // time the readahead thread spent reading shards
+    double wait_seconds;  // time next() waited for a shard
+
+  private:
+    bool pull(ShardRecord &out);
+    void run();
+
+    std::vector<std::string> paths;
+    size_t total;
+    int window_size;
+
+    std::vector<ShardRecord> window;
+    std::vector<ShardRecord> current;  // shard being consumed
+    size_t position;
+    Rng rng;                           // window draws
+
+    // Readahead: the thread loads shard_order[next_shard] into `loaded`
+    std::vector<int> shard_order;
+    size_t next_shard;
+    size_t consumed;                   // shards handed to the consumer this epoch
+    std::deque<std::vector<ShardRecord> > loaded;
+    unsigned int generation;           // bumped by begin_epoch, discards stale reads
+    bool stopping;
+
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable cond;
+
+    ShardStream(const ShardStream &);
+    ShardStream &operator=(const ShardStream &);
+};
+
+#endif // SHARD_STREAM_H
@@ -0,0 +1,589 @@
+// cnn_train: train the CNN on the catalog in data/, save it and evaluate it.
+#include "network.h"
+#include "graph.h"
+#include "perf_counters.h"
+#include "cnn_helper.h"
+#include "checkpoint.h"
+#include "shard_stream.h"
+#include "idx_dataset.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static image_data *all_data, *train_set, *test_set;
+static unsigned int train_cnt, test_cnt;
+static std::vector<std::string> classes;
+static ShardStream *train_stream, *test_stream;
+static MnistSet mnist_train, mnist_test;
+
+static Network net;
+static Graph graph;
+
+static inline void loaddata(const char *data_dir, unsigned int seed, const InputShape &shape)
+{
+	unsigned int total_count;
+
+	// Load all images from the class directories, decoded at the input shape
+	if (discover_classes(data_dir, classes) != 0 ||
+	    load_custom_dataset(&all_data, &total_count, classes, shape, data_dir) != 0) {
+		fprintf(stderr, "Failed to load dataset\n");
+		exit(1);
+	}
+
+	// Split into train and test sets (80/20 split), both views of all_data
+	split_dataset(all_data, total_count, seed, &train_set, &train_cnt, &test_set, &test_cnt);
+}
+
+// --test-image: decode at the network's input shape
+static inline bool loadimage(const char *image_path, const InputShape &shape, std::vector<float> &image)
+{
+	image.resize(shape.pixels());
+	if (load_single_image(image_path, shape, image.data()) != 0) {
+		fprintf(stderr, "Failed to load image: %s\n", image_path);
+		return false;
+	}
+	fprintf(stdout, "\n=== Testing Custom Image ===\n");
+	fprintf(stdout, "Image: %s\n", image_path);
+	return true;
+}
+
+// --stream: build the shard cache on first use, then stream it instead of loading the dataset
+static inline void openstream(const char *data_dir, const char *cache_dir, unsigned int seed, int window)
+{
+	if (!shard_cache_exists(cache_dir)) {
+		fprintf(stdout, "Building shard cache %s from %s\n", cache_dir, data_dir);
+		if (discover_classes(data_dir, classes) != 0 ||
+		    build_shard_cache(data_dir, classes, cache_dir, seed) != 0) {
+			fprintf(stderr, "Failed to build shard cache\n");
+			exit(1);
+		}
+	}
+
+	// The cache lists its own classes (the split was fixed when it was built)
+	if (discover_classes(cache_dir, classes) != 0) {
+		exit(1);
+	}
+	train_stream = new ShardStream(cache_dir, "train", window);
+	test_stream = new ShardStream(cache_dir, "test", 1);
+	if (!train_stream->ok() || !test_stream->ok()) {
+		fprintf(stderr, "Shard cache %s has no train or test shards\n", cache_dir);
+		exit(1);
+	}
+	fprintf(stdout, "Streaming %zu train / %zu test images from %s (shuffle window %d)\n",
+			train_stream->count(), test_stream->count(), cache_dir, window);
+}
+
+// --mnist: map the IDX files; the network gets the 10 digit classes
+static inline void openmnist(const char *mnist_dir)
+{
+	double start = wall_seconds();
+	if (!mnist_train.open(mnist_dir, "train") || !mnist_test.open(mnist_dir, "t10k")) {
+		fprintf(stderr, "Failed to load MNIST from %s\n", mnist_dir);
+		exit(1);
+	}
+	classes.clear();
+	for (int digit = 0; digit < 10; ++digit) {
+		classes.push_back(std::string(1, (char)('0' + digit)));
+	}
+	fprintf(stdout, "MNIST: %zu train / %zu test images mapped from %s in %.3lf s\n",
+			mnist_train.view.count, mnist_test.view.count, mnist_dir, wall_seconds() - start);
+}
+
+// --graph: train or load a layer graph instead of the fixed network
+static int run_graph(const char *graph_path, const char *model_file, bool skip_training, const InputShape &shape,
+                     const TrainOptions &opts, const std::vector<float> *custom_image, bool run_full_test)
+{
+	if (!graph_load_config(graph, graph_path, shape, classes)) {
+		return 1;
+	}
+	graph.optimizer = net.optimizer;
+	graph.init_weights(opts.seed);
+
+	// The model replaces the graph only if it loads completely; otherwise the
+	// --graph config with its seeded weights is trained
+	std::string config = graph.config;
+	if (skip_training && graph_load(graph, model_file)) {
+		if (graph.class_names != classes || graph.shape != shape) {
+			fprintf(stderr, "Model %s was trained on other classes or another input shape\n", model_file);
+			return 1;
+		}
+		if (graph.config != config) {
+			fprintf(stderr, "Model %s was trained with another graph than %s\n", model_file, graph_path);
+			return 1;
+		}
+		fprintf(stdout, "Using pre-trained model from %s\n\n", model_file);
+		graph_print(graph, stdout);
+	} else {
+		if (skip_training) {
+			fprintf(stdout, "Could not load graph model, training new model...\n\n");
+		}
+		graph_print(graph, stdout);
+		graph_learn(graph, train_set, train_cnt, opts, test_set, test_cnt);
+		graph_save(graph, model_file);
+	}
+
+	if (custom_image) {
+		graph_test_single_image(graph, custom_image->data());
+	}
+	if (run_full_test) {
+		graph_test(graph, test_set, test_cnt);
+	}
+	fprintf(stdout, "\n");
+	graph_print_times(graph, stdout);
+	return 0;
+}
+
+int main(int argc, const char **argv) {
+    double start_time = wall_seconds();
+    const char* model_file = "cnn_model.bin";
+    const char* data_dir = "data";
+    const char* cache_dir = nullptr;
+    const char* mnist_dir = nullptr;
+    const char* graph_path = nullptr;
+    bool augment_set = false;
+    bool epochs_set = false;
+    int shuffle_window = 8192;
+    bool skip_training = false;
+    const char* image_path = nullptr;
+    std::vector<float> custom_image;
+    bool test_custom = false;
+    InputShape shape;
+    bool run_full_test = true;
+    bool perf_mode = false;
+    int num_threads = 0;
+    bool resume = false;
+    float val_split = 0;
+    TrainOptions opts;
+    Checkpoint ckpt;
+
+    opts.seed = time(NULL);
+    init_epoch_delay_from_env();
+
+    // Parse command line arguments first
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) {
+            if (i + 1 < argc) {
+                num_threads = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--load") == 0 || strcmp(argv[i], "-l") == 0) {
+            skip_training = true;
+        } else if (strcmp(argv[i], "--model") == 0 || strcmp(argv[i], "-m") == 0) {
+            if (i + 1 < argc) {
+                model_file = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--data") == 0 || strcmp(argv[i], "-d") == 0) {
+            if (i + 1 < argc) {
+                data_dir = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            if (i + 1 < argc) {
+                cache_dir = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--mnist") == 0) {
+            if (i + 1 < argc) {
+                mnist_dir = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--shuffle-window") == 0) {
+            if (i + 1 < argc) {
+                shuffle_window = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--test-image") == 0 || strcmp(argv[i], "-i") == 0) {
+            if (i + 1 < argc) {
+                image_path = argv[++i];
+                test_custom = true;
+            }
+        } else if (strcmp(argv[i], "--input-size") == 0) {
+            if (i + 1 < argc) {
+                shape.size = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--channels") == 0) {
+            if (i + 1 < argc) {
+                shape.channels = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--graph") == 0) {
+            if (i + 1 < argc) {
+                graph_path = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--no-test") == 0) {
+            run_full_test = false;
+        } else if (strcmp(argv[i], "--epochs") == 0 || strcmp(argv[i], "-e") == 0) {
+            if (i + 1 < argc) {
+                opts.epochs = atoi(argv[++i]);
+                epochs_set = true;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            if (i + 1 < argc) {
+                opts.seed = strtoul(argv[++i], nullptr, 10);
+            }
+        } else if (strcmp(argv[i], "--loss") == 0) {
+            if (i + 1 < argc) {
+                const char *loss = argv[++i];
+                if (strcmp(loss, "softmax") == 0) {
+                    net.head = HEAD_SOFTMAX;
+                } else if (strcmp(loss, "sigmoid") == 0) {
+                    net.head = HEAD_SIGMOID;
+                } else {
+                    fprintf(stderr, "Unknown --loss '%s' (expected sigmoid or softmax)\n", loss);
+                    return 1;
+                }
+            }
+        } else if (strcmp(argv[i], "--optimizer") == 0) {
+            if (i + 1 < argc) {
+                const char *name = argv[++i];
+                int k = OPT_SGD;
+                while (k <= OPT_ADAM && strcmp(name, optimizer_name((OptimizerKind)k)) != 0) {
+                    ++k;
+                }
+                if (k > OPT_ADAM) {
+                    fprintf(stderr, "Unknown --optimizer '%s' (expected sgd, momentum, nesterov or adam)\n", name);
+                    return 1;
+                }
+                net.optimizer.kind = (OptimizerKind)k;
+            }
+        } else if (strcmp(argv[i], "--lr") == 0) {
+            if (i + 1 < argc) {
+                opts.learning_rate = atof(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--momentum") == 0) {
+            if (i + 1 < argc) {
+                net.optimizer.momentum = atof(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--checkpoint") == 0) {
+            if (i + 1 < argc) {
+                opts.checkpoint_path = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--checkpoint-every") == 0) {
+            if (i + 1 < argc) {
+                opts.checkpoint_every = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            resume = true;
+        } else if (strcmp(argv[i], "--val-split") == 0) {
+            if (i + 1 < argc) {
+                val_split = atof(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--val-every") == 0) {
+            if (i + 1 < argc) {
+                opts.val_every = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--patience") == 0) {
+            if (i + 1 < argc) {
+                opts.patience = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--pipeline-batch") == 0) {
+            if (i + 1 < argc) {
+                opts.pipeline_batch = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--augment") == 0) {
+            if (i + 1 < argc) {
+                const char *spec = argv[++i];
+                if (!opts.augment.parse(spec)) {
+                    fprintf(stderr, "Invalid --augment '%s' (see --help)\n", spec);
+                    return 1;
+                }
+                augment_set = true;
+            }
+        } else if (strcmp(argv[i], "--layout") == 0) {
+            if (i + 1 < argc) {
+                const char *name = argv[++i];
+                if (!parse_layout(name, infer_layout)) {
+                    fprintf(stderr, "Unknown --layout '%s' (expected nchw, nhwc or nchw8c)\n", name);
+                    return 1;
+                }
+            }
+        } else if (strcmp(argv[i], "--conv") == 0) {
+            if (i + 1 < argc) {
+                const char *name = argv[++i];
+                if (!parse_conv_engine(name, conv_engine)) {
+                    fprintf(stderr, "Unknown --conv '%s' (expected direct, im2col, winograd, fft or auto)\n", name);
+                    return 1;
+                }
+            }
+        } else if (strcmp(argv[i], "--infer-batch") == 0) {
+            if (i + 1 < argc) {
+                infer_batch = atoi(argv[++i]);
+                if (infer_batch < 1) {
+                    infer_batch = 1;
+                }
+            }
+        } else if (strcmp(argv[i], "--no-pipeline") == 0) {
+            opts.pipeline_async = false;
+        } else if (strcmp(argv[i], "--target-accuracy") == 0) {
+            if (i + 1 < argc) {
+                opts.target_accuracy = atof(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--epoch-delay") == 0) {
+            if (i + 1 < argc) {
+                epoch_delay_ms = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            perf_mode = true;
+        } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [OPTIONS]\n", argv[0]);
+            printf("Options:\n");
+            printf("  -t, --threads <N>       Set number of OpenMP threads (openmp backend)\n");
+            printf("  --load, -l              Load pre-trained model instead of training\n");
+            printf("  --model, -m <file>      Specify model file (default: cnn_model.bin)\n");
+            printf("  --data, -d <dir>        Dataset directory (default: data)\n");
+            printf("  --stream <dir>          Stream the dataset from a shard cache in <dir> (built from --data on first use)\n");
+            printf("  --shuffle-window <N>    Records shuffled together when streaming (default: 8192)\n");
+            printf("  --mnist <dir>           Train the 10-class network on memory-mapped MNIST IDX files in <dir>\n");
+            printf("  --test-image, -i <file> Test a single custom image\n");
+            printf("  --input-size <N>        Input width and height in pixels, 8 plus a multiple of 4 (default: 28)\n");
+            printf("  --channels <1|3>        Input channels: 1 grayscale or 3 RGB (default: 1)\n");
+            printf("  --graph <file>          Train a layer graph from a config file instead of the fixed network\n");
+            printf("                          (see src/graph.h and configs/; -m saves and --load reads a graph model)\n");
+            printf("  --no-test               Skip validation dataset testing\n");
+            printf("  --epochs, -e <N>        Number of training epochs (default: 80)\n");
+            printf("  --seed <N>              Seed for initialization, split, shuffling and augmentation (default: time)\n");
+            printf("  --loss <sigmoid|softmax> Output head: sigmoid or softmax + cross-entropy (default: sigmoid)\n");
+            printf("  --optimizer <name>      sgd, momentum, nesterov or adam (default: sgd)\n");
+            printf("  --lr <rate>             Initial learning rate (default: 0.05 sgd, 0.005 momentum/nesterov, 0.001 adam)\n");
+            printf("  --momentum <mu>         Momentum for momentum/nesterov (default: 0.9)\n");
+            printf("  --checkpoint <file>     Checkpoint file (default: cnn_checkpoint.bin)\n");
+            printf("  --checkpoint-every <N>  Write a checkpoint every N epochs in the background (default: off)\n");
+            printf("  --resume                Continue training from the checkpoint file (--epochs overrides its epoch count)\n");
+            printf("  --val-split <F>         Hold out this fraction of the training set for validation\n");
+            printf("                          (default: 0.1 when --val-every or --patience is given)\n");
+            printf("  --val-every <K>         Validate every K epochs in the background, keep the best weights (default: 1)\n");
+            printf("  --patience <P>          Stop after P validations without improvement (default: off)\n");
+            printf("  --pipeline-batch <N>    Samples prepared per pipeline batch (default: 64)\n");
+            printf("  --augment <ops>         Augmentation from epoch 11, e.g. p=0.5,flip,shift=2,rotate=10,\n");
+            printf("                          brightness=0.1,contrast=0.2,noise=0.05 or none (default: p=0.5,flip,noise=0.05)\n");
+            printf("  --no-pipeline           Augment on the training thread instead of in the background\n");
+            printf("  --layout <name>         Activation layout of batched evaluation: nchw, nhwc or nchw8c (default: nchw)\n");
+            printf("  --infer-batch <N>       Samples per batched forward pass in evaluation (default: 64)\n");
+            printf("  --conv <engine>         First layer in evaluation with --layout nchw: direct, im2col, winograd,\n");
+            printf("                          fft or auto (fastest for the input size, default: direct)\n");
+            printf("  --target-accuracy <%%>   Stop training once test accuracy reaches this value\n");
+            printf("  --epoch-delay <ms>      Sleep between epochs (default: $VISUALSEARCH_DELAY_MS or 0)\n");
+            printf("  --perf                  Collect hardware performance counters per kernel/epoch\n");
+            printf("  --help, -h              Show this help message\n");
+            printf("\nExample: %s -t 8 --epochs 20 --seed 42\n", argv[0]);
+            return 0;
+        }
+    }
+
+    // The seed decides the train/test split, so it must come from the checkpoint
+    if (resume) {
+        if (!checkpoint_read(ckpt, opts.checkpoint_path)) {
+            fprintf(stderr, "Failed to read checkpoint %s\n", opts.checkpoint_path);
+            return 1;
+        }
+        opts.seed = ckpt.seed;
+        // The learning rate schedule depends only on the epoch, so a run can be extended or shortened
+        if (epochs_set && opts.epochs != ckpt.total_epochs) {
+            if (opts.epochs <= ckpt.epoch) {
+                fprintf(stderr, "Checkpoint %s is already at epoch %d; --epochs %d leaves nothing to train\n",
+                        opts.checkpoint_path, ckpt.epoch, opts.epochs);
+                return 1;
+            }
+            fprintf(stdout, "Resuming with --epochs %d instead of the checkpoint's %d\n", opts.epochs,
+                    ckpt.total_epochs);
+            ckpt.total_epochs = opts.epochs;
+        }
+    }
+
+    if ((opts.val_every > 0 || opts.patience > 0) && val_split <= 0) {
+        val_split = 0.1f;
+    }
+    if (val_split > 0 && opts.val_every <= 0) {
+        opts.val_every = 1;
+    }
+    if ((cache_dir || mnist_dir) && val_split > 0) {
+        fprintf(stderr, "--val-split/--val-every/--patience need the in-memory dataset; use --target-accuracy with --stream or --mnist\n");
+        return 1;
+    }
+    if (cache_dir && mnist_dir) {
+        fprintf(stderr, "--stream and --mnist cannot be combined\n");
+        return 1;
+    }
+    if (!shape.valid()) {
+        fprintf(stderr, "Invalid input shape %dx%d with %d channels (size 8 plus a multiple of 4 up to %d, 1 or 3 channels)\n",
+                shape.size, shape.size, shape.channels, InputShape::max_size);
+        return 1;
+    }
+    // Shard caches and IDX files hold 28x28 grayscale bytes
+    if ((cache_dir || mnist_dir) && shape != InputShape()) {
+        fprintf(stderr, "--stream and --mnist need the default 28x28 grayscale input\n");
+        return 1;
+    }
+    if (graph_path && (cache_dir || mnist_dir || resume || opts.checkpoint_every > 0 || val_split > 0)) {
+        fprintf(stderr, "--graph trains from the in-memory dataset without checkpoints or validation\n");
+        return 1;
+    }
+    // Horizontal flips do not suit digits
+    if (mnist_dir && !augment_set) {
+        opts.augment.parse("none");
+    }
+
+
+    // Open counters before the OpenMP thread pool exists so workers inherit them
+    if (perf_mode) {
+        perf_init();
+    }
+
+#ifdef _OPENMP
+    if (num_threads > 0) {
+        omp_set_num_threads(num_threads);
+        fprintf(stdout, "OpenMP: set number of threads to %d\n", num_threads);
+    } else {
+        fprintf(stdout, "OpenMP: using default number of threads (%d)\n", omp_get_max_threads());
+    }
+#else
+    if (num_threads > 1) {
+        fprintf(stderr, "Warning: %s backend ignores --threads %d\n", CNN_BACKEND_NAME, num_threads);
+    }
+#endif
+
+    // If just testing a custom image with loaded model, skip dataset loading
+    if (graph_path && skip_training && test_custom && !run_full_test) {
+        if (!graph_load(graph, model_file)) {
+            fprintf(stderr, "Failed to load graph model from %s\n", model_file);
+            return 1;
+        }
+        if (!loadimage(image_path, graph.shape, custom_image)) {
+            return 1;
+        }
+        fprintf(stdout, "Model loaded from %s\n\n", model_file);
+        graph_test_single_image(graph, custom_image.data());
+        return 0;
+    }
+    if (skip_training && test_custom && !run_full_test) {
+        if (load_model(net, model_file)) {
+            if (!loadimage(image_path, net.shape, custom_image)) {
+                return 1;
+            }
+            fprintf(stdout, "Model loaded from %s\n\n", model_file);
+            test_single_image(net, custom_image.data());
+            return 0;
+        } else {
+            fprintf(stderr, "Failed to load model from %s\n", model_file);
+            return 1;
+        }
+    }
+    if (test_custom && !loadimage(image_path, shape, custom_image)) {
+        return 1;
+    }
+    fprintf(stdout ,"Visual Search Using CNN\n 2023BCS0017 - Jen Jose Jeeson\n 2023BCS0053 - Jefin Francis\n");
+    // Load dataset only if we need to train or run full test
+    if (cache_dir) {
+        openstream(data_dir, cache_dir, opts.seed, shuffle_window);
+        opts.train_stream = train_stream;
+        opts.eval_stream = test_stream;
+    } else if (mnist_dir) {
+        openmnist(mnist_dir);
+        opts.train_bytes = &mnist_train.view;
+        opts.eval_bytes = &mnist_test.view;
+    } else {
+        double load_start = wall_seconds();
+        loaddata(data_dir, opts.seed, shape);
+        fprintf(stdout, "Dataset loaded in %.2lf s, peak RSS %.1f MB\n", wall_seconds() - load_start, peak_rss_mb());
+    }
+    double startup_seconds = wall_seconds() - start_time;
+
+    if (graph_path) {
+        int status = run_graph(graph_path, model_file, skip_training, shape, opts,
+                               test_custom ? &custom_image : nullptr, run_full_test);
+        if (status == 0) {
+            fprintf(stdout, "\nThroughput - startup: %.3f s, train: %.1f samples/s, inference: %.1f images/s\n",
+                    startup_seconds,
+                    train_seconds > 0 ? train_samples / train_seconds : 0.0,
+                    infer_seconds > 0 ? infer_samples / infer_seconds : 0.0);
+        }
+        free(all_data);
+        return status;
+    }
+
+    // One output per class; weight initialization, split and augmentation all derive from the seed
+    net.set_shape(shape);
+    net.set_classes(classes);
+    net.init_weights(opts.seed);
+
+    // Try to load existing model or train new one
+    if (skip_training && load_model(net, model_file)) {
+        if (net.class_names != classes) {
+            fprintf(stderr, "Model %s was trained on different classes than %s\n", model_file, data_dir);
+            return 1;
+        }
+        if (net.shape != shape) {
+            fprintf(stderr, "Model %s takes %dx%d input with %d channel(s); pass --input-size %d --channels %d\n",
+                    model_file, net.shape.size, net.shape.size, net.shape.channels, net.shape.size, net.shape.channels);
+            return 1;
+        }
+        fprintf(stdout, "Using pre-trained model from %s\n\n", model_file);
+    } else {
+        if (skip_training) {
+            fprintf(stdout, "Could not load model, training new model...\n\n");
+        }
+        if (resume) {
+            // Labels are indices into the class list, so a reordered list would permute them
+            if (ckpt.class_names != classes) {
+                fprintf(stderr, "Checkpoint %s was trained on different classes than %s\n", opts.checkpoint_path,
+                        data_dir);
+                return 1;
+            }
+            if (ckpt.shape != shape) {
+                fprintf(stderr, "Checkpoint %s takes %dx%d input with %d channel(s); pass --input-size %d --channels %d\n",
+                        opts.checkpoint_path, ckpt.shape.size, ckpt.shape.size, ckpt.shape.channels,
+                        ckpt.shape.size, ckpt.shape.channels);
+                return 1;
+            }
+            if (!checkpoint_restore(net, ckpt)) {
+                fprintf(stderr, "Checkpoint %s does not match this network\n", opts.checkpoint_path);
+                return 1;
+            }
+            opts.resume_from = &ckpt;
+        }
+        // Validation set: the tail of the (already shuffled) training split
+        image_data *eval_set = test_set;
+        unsigned int eval_cnt = test_cnt;
+        unsigned int fit_cnt = train_cnt;
+        if (val_split > 0) {
+            eval_cnt = (unsigned int)(train_cnt * val_split);
+            fit_cnt = train_cnt - eval_cnt;
+            eval_set = train_set + fit_cnt;
+            fprintf(stdout, "Validation set: %u images held out of the training set\n", eval_cnt);
+        }
+        learn(net, train_set, fit_cnt, opts, eval_set, eval_cnt);
+        save_model(net, model_file);
+    }
+
+    // Test on custom image if provided
+    if (test_custom) {
+        test_single_image(net, custom_image.data());
+    }
+
+    // Run full test if requested
+    if (run_full_test) {
+        if (test_stream) {
+            test(net, *test_stream);
+        } else if (mnist_dir) {
+            test(net, mnist_test.view);
+        } else {
+            test(net, test_set, test_cnt);
+        }
+    }
+
+    printf("\nTotal Convolution Time: %f ms\n", total_convolution_time);
+    printf("Total Pooling Time: %f ms\n", total_pooling_time);
+    printf("Total Fully Connected Time: %f ms\n", total_fully_connected_time);
+    printf("Total Time on applying gradients: %f ms\n", total_gradient_time);
+
+    fprintf(stdout, "\nThroughput - startup: %.3f s, train: %.1f samples/s, inference: %.1f images/s\n",
+            startup_seconds,
+            train_seconds > 0 ? train_samples / train_seconds : 0.0,
+            infer_seconds > 0 ? infer_samples / infer_seconds : 0.0);
+
+    perf_report();
+    perf_close();
+
+    delete train_stream;
+    delete test_stream;
+    free(all_data);
+    return 0;
+}